@@ -0,0 +1,54 @@
+#ifndef _BENCHMARK_ANALYTIC_SOLUTIONS_H_
+#define _BENCHMARK_ANALYTIC_SOLUTIONS_H_
+
+#include <base/Eigen.hpp>
+#include <base/Pose.hpp>
+#include <cmath>
+
+/**
+ * Analytic solutions of the torque-free motion of an axisymmetric rigid body
+ * (symmetry axis z, transverse inertia Jt, axial inertia J3).
+ *
+ * Andrle, Michael S., and John L. Crassidis. "Geometric integration of quaternions." Journal of Guidance, Control, and Dynamics 36.6 (2013): 1762-1767.
+ */
+
+/** Angular velocity at time t
+ *
+ * @param omega0 initial angular velocity
+ * @param t time
+ * @param omegan body nutation rate, omega0[2]*(Jt - J3)/Jt
+ */
+inline base::Vector3d calcOmega(base::Vector3d omega0, double t, double omegan)
+{
+    base::Vector3d ome;
+    ome[0] = omega0[0]*cos(omegan*t) + omega0[1]*sin(omegan*t);
+    ome[1] = omega0[1]*cos(omegan*t) - omega0[0]*sin(omegan*t);
+    ome[2] = omega0[2];
+    return ome;
+}
+
+/** Orientation at time t
+ *
+ * @param init_ori initial orientation
+ * @param t time
+ * @param wn body nutation rate
+ * @param wi inertial nutation rate, |init_ang_mom|/Jt
+ * @param init_ang_mom initial angular momentum
+ */
+inline base::Orientation calcOrientation(base::Orientation init_ori, double t, double wn, double wi, base::Vector3d init_ang_mom)
+{
+    base::Vector3d h0 = init_ang_mom/init_ang_mom.norm();
+    double alpha = wn*t/2;
+    double betha = wi*t/2;
+
+    base::Vector4d y;
+    y[0] = h0[0]*cos(alpha)*sin(betha) + h0[1]*sin(alpha)*sin(betha);
+    y[1] = h0[1]*cos(alpha)*sin(betha) - h0[0]*sin(alpha)*sin(betha);
+    y[2] = h0[2]*cos(alpha)*sin(betha) + sin(alpha)*cos(betha);
+    y[3] = cos(alpha)*cos(betha) - h0[2]*sin(alpha)*sin(betha);
+
+    base::Orientation Y(y[3], y[0], y[1], y[2] );
+    return Y*init_ori;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef _BENCHMARK_VEHICLES_H_
+#define _BENCHMARK_VEHICLES_H_
+
+#include <uwv_dynamic_model/DataTypes.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Parameter sets used by the benchmarks.
+ *
+ * Orders of magnitude of a few vehicles: the unit vehicle of the test suite,
+ * a 150 kg torpedo shaped AUV, a box shaped work class ROV with coupled
+ * inertia, and the same AUV with the six coupled quadratic damping matrices
+ * of the COMPLEX model.
+ */
+namespace benchmark
+{
+struct Vehicle
+{
+    std::string name;
+    uwv_dynamic_model::UWVParameters parameters;
+};
+
+inline base::Matrix6d diagonal(double a, double b, double c, double d, double e, double f)
+{
+    base::Vector6d values;
+    values << a, b, c, d, e, f;
+    return values.asDiagonal();
+}
+
+inline Vehicle unitVehicle(uwv_dynamic_model::ModelType model_type)
+{
+    Vehicle vehicle;
+    vehicle.name = "unit";
+    vehicle.parameters.model_type = model_type;
+    vehicle.parameters.inertia_matrix = base::Matrix6d::Identity();
+    vehicle.parameters.damping_matrices.resize(model_type == uwv_dynamic_model::COMPLEX ? 6 : 2);
+    for(size_t i = 0; i < vehicle.parameters.damping_matrices.size(); i++)
+        vehicle.parameters.damping_matrices[i] = base::Matrix6d::Identity();
+    return vehicle;
+}
+
+inline Vehicle auv(uwv_dynamic_model::ModelType model_type)
+{
+    Vehicle vehicle;
+    vehicle.name = "auv";
+    uwv_dynamic_model::UWVParameters &parameters = vehicle.parameters;
+    parameters.model_type = model_type;
+    // Rigid body plus added mass
+    parameters.inertia_matrix = diagonal(150 + 8, 150 + 120, 150 + 120, 4 + 1, 40 + 25, 40 + 25);
+    parameters.inertia_matrix(4, 2) = parameters.inertia_matrix(2, 4) = -6;
+    parameters.inertia_matrix(5, 1) = parameters.inertia_matrix(1, 5) = 6;
+    parameters.weight = 150 * 9.81;
+    parameters.buoyancy = 151 * 9.81;
+    parameters.distance_body2centerofgravity = base::Vector3d(0, 0, -0.02);
+    parameters.distance_body2centerofbuoyancy = base::Vector3d(0.01, 0, 0.03);
+
+    if(model_type == uwv_dynamic_model::COMPLEX)
+    {
+        parameters.damping_matrices.resize(6);
+        base::Vector6d quadratic;
+        quadratic << 45, 310, 310, 2, 60, 60;
+        for(size_t i = 0; i < 6; i++)
+        {
+            parameters.damping_matrices[i] = base::Matrix6d::Zero();
+            parameters.damping_matrices[i](i, i) = quadratic[i];
+        }
+        // Coupling between heave/pitch and sway/yaw
+        parameters.damping_matrices[2](4, 2) = 12;
+        parameters.damping_matrices[4](2, 4) = 8;
+        parameters.damping_matrices[1](5, 1) = -12;
+        parameters.damping_matrices[5](1, 5) = -8;
+    }
+    else
+    {
+        parameters.damping_matrices.resize(2);
+        parameters.damping_matrices[0] = diagonal(12, 90, 90, 1, 25, 25);
+        parameters.damping_matrices[1] = diagonal(45, 310, 310, 2, 60, 60);
+    }
+    return vehicle;
+}
+
+inline Vehicle rov(uwv_dynamic_model::ModelType model_type)
+{
+    Vehicle vehicle;
+    vehicle.name = "rov";
+    uwv_dynamic_model::UWVParameters &parameters = vehicle.parameters;
+    parameters.model_type = model_type;
+    parameters.inertia_matrix = diagonal(3000 + 1800, 3000 + 2600, 3000 + 4200, 1400 + 600, 1900 + 900, 1600 + 800);
+    parameters.inertia_matrix(0, 4) = parameters.inertia_matrix(4, 0) = 150;
+    parameters.inertia_matrix(1, 3) = parameters.inertia_matrix(3, 1) = -150;
+    parameters.weight = 3000 * 9.81;
+    parameters.buoyancy = 3010 * 9.81;
+    parameters.distance_body2centerofgravity = base::Vector3d(0, 0, -0.3);
+    parameters.distance_body2centerofbuoyancy = base::Vector3d(0, 0, 0.2);
+
+    if(model_type == uwv_dynamic_model::COMPLEX)
+    {
+        parameters.damping_matrices.resize(6);
+        base::Vector6d quadratic;
+        quadratic << 1800, 2400, 3600, 900, 1100, 800;
+        for(size_t i = 0; i < 6; i++)
+        {
+            parameters.damping_matrices[i] = base::Matrix6d::Zero();
+            parameters.damping_matrices[i](i, i) = quadratic[i];
+        }
+    }
+    else
+    {
+        parameters.damping_matrices.resize(2);
+        parameters.damping_matrices[0] = diagonal(600, 800, 1200, 500, 600, 400);
+        parameters.damping_matrices[1] = diagonal(1800, 2400, 3600, 900, 1100, 800);
+    }
+    return vehicle;
+}
+
+/** All vehicles for a model type
+ *
+ */
+inline std::vector<Vehicle> loadVehicles(uwv_dynamic_model::ModelType model_type)
+{
+    std::vector<Vehicle> vehicles;
+    vehicles.push_back(unitVehicle(model_type));
+    vehicles.push_back(auv(model_type));
+    vehicles.push_back(rov(model_type));
+    return vehicles;
+}
+
+/** Representative efforts for a vehicle, about a third of its full thrust
+ *
+ */
+inline base::Vector6d typicalEffort(const Vehicle &vehicle)
+{
+    base::Vector6d effort;
+    effort << 0.2, 0.05, -0.05, 0.01, 0.02, 0.05;
+    return vehicle.parameters.inertia_matrix.diagonal().cwiseProduct(effort);
+}
+};
+#endif
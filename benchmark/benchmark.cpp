@@ -0,0 +1,129 @@
+#include <uwv_dynamic_model/ModelSimulation.hpp>
+#include "Vehicles.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * Performance baseline of the library.
+ *
+ * Usage:
+ *
+ * # ./uwv_dynamic_model_benchmark [min_time_per_case_in_seconds]
+ *
+ * Writes one CSV line per case to the standard output:
+ *  benchmark: calcAcceleration, calcEfforts or sendEffort
+ *  ns_per_op: nanoseconds per call
+ *  ops_per_s: calls per second
+ *  ns_per_step: nanoseconds per integration step (sendEffort only)
+ */
+
+using namespace uwv_dynamic_model;
+
+namespace
+{
+volatile double sink;
+
+const char* modelName(ModelType model_type)
+{
+    static const char* names[] = {"SIMPLE", "COMPLEX", "INTERMEDIATE"};
+    return names[model_type];
+}
+
+const char* simulatorName(ModelSimulator simulator)
+{
+    return simulator == DYNAMIC ? "DYNAMIC" : "DYNAMIC_KINEMATIC";
+}
+
+/** Run function until min_time is elapsed, doubling the number of iterations
+ *
+ * @return nanoseconds per call and number of calls of the last run
+ */
+template<class Function>
+std::pair<double, long> measure(Function function, double min_time)
+{
+    typedef std::chrono::steady_clock Clock;
+    long iterations = 16;
+    while(true)
+    {
+        Clock::time_point start = Clock::now();
+        for(long i = 0; i < iterations; i++)
+            function();
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if(elapsed >= min_time || iterations > (1l << 40))
+            return std::make_pair(elapsed * 1e9 / iterations, iterations);
+        iterations *= 2;
+    }
+}
+
+void printLine(const std::string &benchmark, const benchmark::Vehicle &vehicle, const std::string &simulator,
+        int sim_per_cycle, const std::pair<double, long> &result)
+{
+    std::cout << benchmark << "," << vehicle.name << "," << modelName(vehicle.parameters.model_type) << ","
+            << simulator << "," << sim_per_cycle << "," << result.second << ","
+            << result.first << "," << 1e9 / result.first << ","
+            << (sim_per_cycle > 0 ? result.first / sim_per_cycle : result.first) << std::endl;
+}
+}
+
+int main(int argc, char **argv)
+{
+    double min_time = argc > 1 ? atof(argv[1]) : 0.2;
+
+    const ModelType model_types[] = {SIMPLE, INTERMEDIATE, COMPLEX};
+    const ModelSimulator simulators[] = {DYNAMIC, DYNAMIC_KINEMATIC};
+    const int sim_per_cycles[] = {1, 2, 5, 10, 20};
+
+    std::cout << "benchmark,vehicle,model_type,simulator,sim_per_cycle,iterations,ns_per_op,ops_per_s,ns_per_step" << std::endl;
+
+    for(size_t m = 0; m < sizeof(model_types) / sizeof(model_types[0]); m++)
+    {
+        std::vector<benchmark::Vehicle> vehicles = benchmark::loadVehicles(model_types[m]);
+        for(size_t v = 0; v < vehicles.size(); v++)
+        {
+            const benchmark::Vehicle &vehicle = vehicles[v];
+            DynamicModel model;
+            model.setUWVParameters(vehicle.parameters);
+
+            base::Vector6d effort = benchmark::typicalEffort(vehicle);
+            base::Vector6d velocity;
+            velocity << 1.2, 0.1, -0.05, 0.02, 0.03, 0.1;
+            base::Orientation orientation(Eigen::AngleAxisd(0.3, base::Vector3d(0.1, 0.2, 1).normalized()));
+
+            printLine("calcAcceleration", vehicle, "-", 0, measure([&]()
+            {
+                sink = model.calcAcceleration(effort, velocity, orientation)[0];
+            }, min_time));
+
+            base::Vector6d acceleration = model.calcAcceleration(effort, velocity, orientation);
+            printLine("calcEfforts", vehicle, "-", 0, measure([&]()
+            {
+                sink = model.calcEfforts(acceleration, velocity, orientation)[0];
+            }, min_time));
+
+            for(size_t s = 0; s < sizeof(simulators) / sizeof(simulators[0]); s++)
+            {
+                for(size_t c = 0; c < sizeof(sim_per_cycles) / sizeof(sim_per_cycles[0]); c++)
+                {
+                    ModelSimulation simulation(simulators[s], 0.01, sim_per_cycles[c]);
+                    simulation.setUWVParameters(vehicle.parameters);
+                    PoseVelocityState state;
+                    state.linear_velocity = velocity.head<3>();
+                    state.angular_velocity = velocity.tail<3>();
+                    state.orientation = orientation;
+                    simulation.setPose(state);
+
+                    // Restart from the same state so the cost does not drift with the trajectory
+                    long cycle = 0;
+                    printLine("sendEffort", vehicle, simulatorName(simulators[s]), sim_per_cycles[c], measure([&]()
+                    {
+                        if(++cycle % 1000 == 0)
+                            simulation.setPose(state);
+                        sink = simulation.sendEffort(effort).linear_velocity[0];
+                    }, min_time));
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <uwv_dynamic_model/ModelSimulation.hpp>
+#include "AnalyticSolutions.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/**
+ * Accuracy versus cost of the integration.
+ *
+ * Usage:
+ *
+ * # ./uwv_dynamic_model_convergence [duration] [position_tol orientation_tol velocity_tol]
+ *
+ * Simulates the torque-free motion of an axisymmetric body translating at
+ * constant world velocity (the analytic references of test_calc.cpp) for
+ * every integration scheme, sampling_time and simulations_per_cycle, and
+ * writes one CSV line per configuration with the wall time and the final
+ * errors in position [m], orientation [rad] and velocity [m/s, rad/s].
+ * The pareto_* columns flag the configurations for which no other one is
+ * both faster and more accurate for that metric.
+ * Given tolerances, the cheapest configuration meeting all of them is
+ * written to the standard error.
+ */
+
+using namespace uwv_dynamic_model;
+
+namespace
+{
+struct Scenario
+{
+    std::string name;
+    double jt;
+    double j3;
+    base::Vector3d linear_velocity;
+    base::Vector3d angular_velocity;
+};
+
+struct Result
+{
+    std::string scenario;
+    IntegrationScheme scheme;
+    double sampling_time;
+    int sim_per_cycle;
+    double wall_time;
+    double error[3];
+    bool pareto[3];
+};
+
+const char* schemeName(IntegrationScheme scheme)
+{
+    static const char* names[] = {"EULER", "HEUN", "RUNGE_KUTTA_4"};
+    return names[scheme];
+}
+
+Result run(const Scenario &scenario, IntegrationScheme scheme, double sampling_time, int sim_per_cycle, double duration)
+{
+    UWVParameters parameters;
+    parameters.model_type = COMPLEX;
+    parameters.inertia_matrix = base::Matrix6d::Identity();
+    parameters.inertia_matrix(3, 3) = scenario.jt;
+    parameters.inertia_matrix(4, 4) = scenario.jt;
+    parameters.inertia_matrix(5, 5) = scenario.j3;
+    parameters.damping_matrices.resize(6, base::Matrix6d::Zero());
+
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, sampling_time, sim_per_cycle, 0);
+    vehicle.setUWVParameters(parameters);
+    vehicle.setIntegrationScheme(scheme);
+
+    PoseVelocityState init_state;
+    init_state.linear_velocity = scenario.linear_velocity;
+    init_state.angular_velocity = scenario.angular_velocity;
+    vehicle.setPose(init_state);
+
+    base::Vector6d control_input = base::Vector6d::Zero();
+    long cycles = long(duration / sampling_time + 0.5);
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    for(long i = 0; i < cycles; i++)
+        vehicle.sendEffort(control_input);
+    double wall_time = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Analytic solution: torque-free rotation, constant velocity in world-frame
+    double t = cycles * sampling_time;
+    double wn = scenario.angular_velocity[2] * (scenario.jt - scenario.j3) / scenario.jt;
+    base::Vector3d init_ang_mom(scenario.jt * scenario.angular_velocity[0],
+            scenario.jt * scenario.angular_velocity[1], scenario.j3 * scenario.angular_velocity[2]);
+    double wi = init_ang_mom.norm() / scenario.jt;
+    base::Orientation orientation = calcOrientation(base::Orientation::Identity(), t, wn, wi, init_ang_mom);
+    base::Vector3d angular_velocity = calcOmega(scenario.angular_velocity, t, wn);
+    base::Vector3d position = scenario.linear_velocity * t;
+    base::Vector3d linear_velocity = orientation.inverse() * scenario.linear_velocity;
+
+    PoseVelocityState state = vehicle.getPose();
+    Result result;
+    result.scenario = scenario.name;
+    result.scheme = scheme;
+    result.sampling_time = sampling_time;
+    result.sim_per_cycle = sim_per_cycle;
+    result.wall_time = wall_time;
+    result.error[0] = (state.position - position).norm();
+    result.error[1] = 2 * (state.orientation * orientation.inverse()).vec().norm();
+    result.error[2] = std::sqrt((state.linear_velocity - linear_velocity).squaredNorm() +
+            (state.angular_velocity - angular_velocity).squaredNorm());
+    return result;
+}
+
+/** Flag, for each metric, the configurations not dominated in wall time and error
+ *
+ */
+void markPareto(std::vector<Result> &results)
+{
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        for(size_t m = 0; m < 3; m++)
+        {
+            results[i].pareto[m] = true;
+            for(size_t j = 0; j < results.size() && results[i].pareto[m]; j++)
+            {
+                if(results[j].scenario != results[i].scenario || j == i)
+                    continue;
+                if(results[j].wall_time <= results[i].wall_time && results[j].error[m] <= results[i].error[m] &&
+                        (results[j].wall_time < results[i].wall_time || results[j].error[m] < results[i].error[m]))
+                    results[i].pareto[m] = false;
+            }
+        }
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    double duration = argc > 1 ? atof(argv[1]) : 600;
+    bool has_tolerance = argc > 4;
+    double tolerance[3] = {0, 0, 0};
+    for(size_t m = 0; has_tolerance && m < 3; m++)
+        tolerance[m] = atof(argv[2 + m]);
+
+    std::vector<Scenario> scenarios(2);
+    scenarios[0].name = "constant_yaw";
+    scenarios[0].jt = 1;
+    scenarios[0].j3 = 1;
+    scenarios[0].linear_velocity = base::Vector3d(1, 0, 0);
+    scenarios[0].angular_velocity = base::Vector3d(0, 0, 0.1);
+    scenarios[1].name = "nutation";
+    scenarios[1].jt = 200;
+    scenarios[1].j3 = 100;
+    scenarios[1].linear_velocity = base::Vector3d(1, 0.2, 0);
+    scenarios[1].angular_velocity = base::Vector3d(0.05, 0, 0.01);
+
+    const IntegrationScheme schemes[] = {EULER, HEUN, RUNGE_KUTTA_4};
+    const double sampling_times[] = {0.5, 0.2, 0.1, 0.05, 0.02, 0.01};
+    const int sim_per_cycles[] = {1, 2, 5, 10};
+
+    std::vector<Result> results;
+    for(size_t s = 0; s < scenarios.size(); s++)
+        for(size_t k = 0; k < sizeof(schemes) / sizeof(schemes[0]); k++)
+            for(size_t t = 0; t < sizeof(sampling_times) / sizeof(sampling_times[0]); t++)
+                for(size_t c = 0; c < sizeof(sim_per_cycles) / sizeof(sim_per_cycles[0]); c++)
+                    results.push_back(run(scenarios[s], schemes[k], sampling_times[t], sim_per_cycles[c], duration));
+    markPareto(results);
+
+    std::cout << "scenario,scheme,sampling_time,sim_per_cycle,integration_step,wall_time_s,"
+            << "position_error,orientation_error,velocity_error,pareto_position,pareto_orientation,pareto_velocity" << std::endl;
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result &result = results[i];
+        std::cout << result.scenario << "," << schemeName(result.scheme) << "," << result.sampling_time << ","
+                << result.sim_per_cycle << "," << result.sampling_time / result.sim_per_cycle << ","
+                << result.wall_time << "," << result.error[0] << "," << result.error[1] << "," << result.error[2] << ","
+                << result.pareto[0] << "," << result.pareto[1] << "," << result.pareto[2] << std::endl;
+    }
+
+    for(size_t s = 0; has_tolerance && s < scenarios.size(); s++)
+    {
+        const Result *cheapest = NULL;
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            if(result.scenario != scenarios[s].name || result.error[0] > tolerance[0] ||
+                    result.error[1] > tolerance[1] || result.error[2] > tolerance[2])
+                continue;
+            if(!cheapest || result.wall_time < cheapest->wall_time)
+                cheapest = &result;
+        }
+        std::cerr << scenarios[s].name << ": ";
+        if(cheapest)
+            std::cerr << schemeName(cheapest->scheme) << " sampling_time " << cheapest->sampling_time
+                    << " sim_per_cycle " << cheapest->sim_per_cycle << std::endl;
+        else
+            std::cerr << "no configuration meets the tolerances" << std::endl;
+    }
+    return 0;
+}
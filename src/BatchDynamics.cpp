@@ -0,0 +1,195 @@
+#include "BatchDynamics.hpp"
+#include "DynamicModel.hpp"
+#include "ParallelFor.hpp"
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+namespace
+{
+/**
+ * Rows per block of the batch
+ */
+const size_t BLOCK_ROWS = 1024;
+
+/**
+ * result(:, result_col:result_col+2) -= a(:, a_col:a_col+2) X b(:, b_col:b_col+2), row by row
+ */
+void subtractCross(const base::MatrixXd &a, size_t a_col, const base::MatrixXd &b, size_t b_col,
+                   base::MatrixXd &result, size_t result_col)
+{
+    for(size_t k = 0; k < 3; k++)
+    {
+        size_t k1 = (k + 1) % 3;
+        size_t k2 = (k + 2) % 3;
+        result.col(result_col + k).array() -= a.col(a_col + k1).array() * b.col(b_col + k2).array() -
+                a.col(a_col + k2).array() * b.col(b_col + k1).array();
+    }
+}
+}
+
+BatchDynamics::BatchDynamics(const UWVParameters &uwv_parameters)
+{
+    setUWVParameters(uwv_parameters);
+}
+
+BatchDynamics::~BatchDynamics()
+{
+}
+
+void BatchDynamics::setUWVParameters(const UWVParameters &uwv_parameters)
+{
+    // Same checks as the single sample model
+    DynamicModel model;
+    model.setUWVParameters(uwv_parameters);
+    this->uwv_parameters = uwv_parameters;
+    Eigen::JacobiSVD<base::MatrixXd> svd(uwv_parameters.inertia_matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    invert_inertia_matrix = svd.solve(base::Matrix6d::Identity());
+}
+
+UWVParameters BatchDynamics::getUWVParameters() const
+{
+    return uwv_parameters;
+}
+
+void BatchDynamics::checkSize(const base::MatrixXd &matrix, size_t rows, size_t cols, const std::string &name) const
+{
+    if(size_t(matrix.rows()) != rows || size_t(matrix.cols()) != cols)
+        throw std::invalid_argument("BatchDynamics: " + name + " must be a N x " + std::to_string(cols) +
+                " matrix with the same N as the velocities");
+}
+
+base::MatrixXd BatchDynamics::calcEfforts(const base::MatrixXd &accelerations, const base::MatrixXd &velocities,
+        const base::MatrixXd &orientations, unsigned int n_threads) const
+{
+    const size_t n = velocities.rows();
+    checkSize(velocities, n, 6, "velocities");
+    checkSize(accelerations, n, 6, "accelerations");
+    checkSize(orientations, n, 4, "orientations");
+
+    base::MatrixXd efforts(n, 6);
+    size_t n_blocks = (n + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    parallelFor(n_blocks, n_threads, [&](size_t block)
+    {
+        size_t begin = block * BLOCK_ROWS;
+        calcEffortsBlock(accelerations, velocities, orientations, begin, std::min(BLOCK_ROWS, n - begin), efforts);
+    });
+    return efforts;
+}
+
+base::MatrixXd BatchDynamics::calcAcceleration(const base::Vector6d &control_input, const base::MatrixXd &velocities,
+        const base::MatrixXd &orientations, unsigned int n_threads) const
+{
+    const size_t n = velocities.rows();
+    checkSize(velocities, n, 6, "velocities");
+    checkSize(orientations, n, 4, "orientations");
+
+    base::MatrixXd accelerations(n, 6);
+    size_t n_blocks = (n + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    parallelFor(n_blocks, n_threads, [&](size_t block)
+    {
+        size_t begin = block * BLOCK_ROWS;
+        size_t rows = std::min(BLOCK_ROWS, n - begin);
+        // M^(-1) * (efforts - velocity efforts), row by row
+        base::MatrixXd efforts = -calcVelocityEffortsBlock(velocities, orientations, begin, rows);
+        efforts.rowwise() += control_input.transpose();
+        accelerations.middleRows(begin, rows) = efforts * invert_inertia_matrix.transpose();
+    });
+    return accelerations;
+}
+
+base::MatrixXd BatchDynamics::calcEfforts(const base::MatrixXd &velocities, const base::MatrixXd &orientations,
+        double sampling_time, unsigned int n_threads) const
+{
+    return calcEfforts(calcAccelerations(velocities, sampling_time), velocities, orientations, n_threads);
+}
+
+base::MatrixXd BatchDynamics::calcAccelerations(const base::MatrixXd &velocities, double sampling_time)
+{
+    const size_t n = velocities.rows();
+    if(n < 2 || velocities.cols() != 6)
+        throw std::invalid_argument("BatchDynamics: velocities must be a N x 6 matrix with N >= 2");
+    if(sampling_time <= 0)
+        throw std::invalid_argument("BatchDynamics: sampling_time must be positive");
+
+    base::MatrixXd accelerations(n, 6);
+    if(n == 2)
+    {
+        accelerations.row(0) = (velocities.row(1) - velocities.row(0)) / sampling_time;
+        accelerations.row(1) = accelerations.row(0);
+        return accelerations;
+    }
+
+    accelerations.middleRows(1, n - 2) = (velocities.bottomRows(n - 2) - velocities.topRows(n - 2)) / (2 * sampling_time);
+    accelerations.row(0) = (-3 * velocities.row(0) + 4 * velocities.row(1) - velocities.row(2)) / (2 * sampling_time);
+    accelerations.row(n - 1) = (3 * velocities.row(n - 1) - 4 * velocities.row(n - 2) + velocities.row(n - 3)) /
+            (2 * sampling_time);
+    return accelerations;
+}
+
+void BatchDynamics::calcEffortsBlock(const base::MatrixXd &accelerations, const base::MatrixXd &velocities,
+        const base::MatrixXd &orientations, size_t begin, size_t n, base::MatrixXd &efforts) const
+{
+    // Inertia: M*a
+    efforts.middleRows(begin, n) = accelerations.middleRows(begin, n) * uwv_parameters.inertia_matrix.transpose() +
+            calcVelocityEffortsBlock(velocities, orientations, begin, n);
+}
+
+base::MatrixXd BatchDynamics::calcVelocityEffortsBlock(const base::MatrixXd &velocities, const base::MatrixXd &orientations,
+        size_t begin, size_t n) const
+{
+    const base::MatrixXd velocity = velocities.middleRows(begin, n);
+    base::MatrixXd effort = base::MatrixXd::Zero(n, 6);
+
+    // Coriolis: -[p_l X w; p_l X v_l + p_a X w], p = M*v
+    if(uwv_parameters.model_type != SIMPLE)
+    {
+        const base::MatrixXd prod = velocity * uwv_parameters.inertia_matrix.transpose();
+        subtractCross(prod, 0, velocity, 3, effort, 0);
+        subtractCross(prod, 0, velocity, 0, effort, 3);
+        subtractCross(prod, 3, velocity, 3, effort, 3);
+    }
+
+    // Damping
+    if(uwv_parameters.model_type == COMPLEX)
+    {
+        // sum(Di * |vi|) * v
+        for(size_t i = 0; i < 6; i++)
+            effort.array() += (velocity * uwv_parameters.damping_matrices[i].transpose()).array().colwise() *
+                    velocity.col(i).array().abs();
+    }
+    else
+    {
+        // linDampingMatrix*v + quadDampingMatrix*|v|*v
+        effort += velocity * uwv_parameters.damping_matrices[0].transpose() +
+                velocity.cwiseAbs().cwiseProduct(velocity) * uwv_parameters.damping_matrices[1].transpose();
+    }
+
+    /** Gravity and buoyancy: [R^T * e3 * (W-B); (cg*W - cb*B) X R^T * e3]
+     *  R^T * e3 is the last row of the rotation matrix of the normalized quaternion
+     */
+    const base::MatrixXd q = orientations.middleRows(begin, n);
+    const Eigen::ArrayXd squared_norm = q.rowwise().squaredNorm().array();
+    const Eigen::ArrayXd x = q.col(0).array();
+    const Eigen::ArrayXd y = q.col(1).array();
+    const Eigen::ArrayXd z = q.col(2).array();
+    const Eigen::ArrayXd w = q.col(3).array();
+    base::MatrixXd world_z(n, 3);
+    world_z.col(0) = (2 * (x * z - w * y) / squared_norm).matrix();
+    world_z.col(1) = (2 * (y * z + w * x) / squared_norm).matrix();
+    world_z.col(2) = (1 - 2 * (x * x + y * y) / squared_norm).matrix();
+
+    const double weight = uwv_parameters.weight;
+    const double buoyancy = uwv_parameters.buoyancy;
+    const base::Vector3d moment = uwv_parameters.distance_body2centerofgravity * weight -
+            uwv_parameters.distance_body2centerofbuoyancy * buoyancy;
+    effort.leftCols(3) += world_z * (weight - buoyancy);
+    for(size_t k = 0; k < 3; k++)
+    {
+        size_t k1 = (k + 1) % 3;
+        size_t k2 = (k + 2) % 3;
+        effort.col(3 + k) += moment[k1] * world_z.col(k2) - moment[k2] * world_z.col(k1);
+    }
+    return effort;
+}
+};
@@ -0,0 +1,115 @@
+#ifndef _BATCH_DYNAMICS_H_
+#define _BATCH_DYNAMICS_H_
+
+#include "DataTypes.hpp"
+
+namespace uwv_dynamic_model
+{
+/**********************************************************
+ * Batch Dynamics
+ * Inverse dynamics of many samples at once, e.g. the feedforward
+ * efforts of a reference trajectory.
+ *
+ * Samples are passed in structure of arrays layout: one row per sample
+ * and one column per channel, so each channel is contiguous in memory.
+ *  accelerations: N x 6, linear/angular acceleration in body frame
+ *  velocities: N x 6, linear/angular velocity in body frame
+ *  orientations: N x 4, quaternion coefficients in (x, y, z, w) order
+ *  efforts: N x 6, forces and torques in body frame
+ *
+ * Every term of DynamicModel::calcEfforts is evaluated on whole channels
+ * (matrix products and coefficient-wise operations), for blocks of rows
+ * that can be split between threads.
+ **********************************************************/
+class BatchDynamics
+{
+public:
+    /** Constructor
+     *
+     *  @param uwv_parameters checked as in DynamicModel::setUWVParameters
+     */
+    BatchDynamics(const UWVParameters &uwv_parameters);
+
+    ~BatchDynamics();
+
+    /**
+     * Sets the general UWV parameters
+     * @param uwv_parameters - Structures containing the uwv parameters
+     */
+    void setUWVParameters(const UWVParameters &uwv_parameters);
+
+    /**
+     * Gets the underwater vehicle parameters
+     * @return - Underwater vehicle parameters
+     */
+    UWVParameters getUWVParameters() const;
+
+    /** Compute efforts of N samples
+     *
+     *  @param accelerations N x 6
+     *  @param velocities N x 6
+     *  @param orientations N x 4, not necessarily normalized
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return efforts N x 6
+     */
+    base::MatrixXd calcEfforts(const base::MatrixXd &accelerations, const base::MatrixXd &velocities,
+                               const base::MatrixXd &orientations, unsigned int n_threads = 1) const;
+
+    /** Compute accelerations of N samples with the same efforts
+     *
+     *  Batched DynamicModel::calcAcceleration.
+     *  @param control_input (forces and torques) in body frame
+     *  @param velocities N x 6
+     *  @param orientations N x 4, not necessarily normalized
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return accelerations N x 6
+     */
+    base::MatrixXd calcAcceleration(const base::Vector6d &control_input, const base::MatrixXd &velocities,
+                                    const base::MatrixXd &orientations, unsigned int n_threads = 1) const;
+
+    /** Compute efforts of N samples, accelerations derived from the velocities
+     *
+     *  See calcAccelerations.
+     *  @param velocities N x 6, uniformly sampled
+     *  @param orientations N x 4, not necessarily normalized
+     *  @param sampling_time time between two samples
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return efforts N x 6
+     */
+    base::MatrixXd calcEfforts(const base::MatrixXd &velocities, const base::MatrixXd &orientations,
+                               double sampling_time, unsigned int n_threads = 1) const;
+
+    /** Differentiate a uniformly sampled velocity trajectory
+     *
+     *  Second order finite differences: central for the inner samples,
+     *  one-sided for the first and last ones (first order with two samples).
+     *  @param velocities N x 6, N >= 2
+     *  @param sampling_time time between two samples
+     *  @return accelerations N x 6
+     */
+    static base::MatrixXd calcAccelerations(const base::MatrixXd &velocities, double sampling_time);
+
+private:
+    /**
+     * Efforts of rows [begin, begin+n)
+     */
+    void calcEffortsBlock(const base::MatrixXd &accelerations, const base::MatrixXd &velocities,
+                          const base::MatrixXd &orientations, size_t begin, size_t n, base::MatrixXd &efforts) const;
+
+    /**
+     * Damping, Coriolis and restoring efforts of rows [begin, begin+n)
+     */
+    base::MatrixXd calcVelocityEffortsBlock(const base::MatrixXd &velocities, const base::MatrixXd &orientations,
+                                            size_t begin, size_t n) const;
+
+    void checkSize(const base::MatrixXd &matrix, size_t rows, size_t cols, const std::string &name) const;
+
+    UWVParameters uwv_parameters;
+
+    /**
+     * Inverse of inertia matrix
+     */
+    base::Matrix6d invert_inertia_matrix;
+};
+};
+#endif
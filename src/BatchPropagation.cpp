@@ -0,0 +1,190 @@
+#include "BatchPropagation.hpp"
+#include "ParallelFor.hpp"
+#include "RK4Integrator.hpp"
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+namespace
+{
+/**
+ * States per block
+ */
+const size_t BLOCK_STATES = 256;
+
+/**
+ * a X b, row by row, for the n x 3 blocks of a and b starting at columns a_col and b_col
+ */
+Eigen::ArrayXXd crossRows(const base::MatrixXd &a, size_t a_col, const base::MatrixXd &b, size_t b_col)
+{
+    Eigen::ArrayXXd result(a.rows(), 3);
+    for(size_t k = 0; k < 3; k++)
+    {
+        size_t k1 = (k + 1) % 3;
+        size_t k2 = (k + 2) % 3;
+        result.col(k) = a.col(a_col + k1).array() * b.col(b_col + k2).array() -
+                a.col(a_col + k2).array() * b.col(b_col + k1).array();
+    }
+    return result;
+}
+}
+
+BatchPropagation::BatchPropagation(const UWVParameters &uwv_parameters, ModelSimulator sim, double sampling_time,
+                                   int sim_per_cycle)
+    : dynamics(uwv_parameters), simulator(sim), sampling_time(sampling_time), simulations_per_cycle(sim_per_cycle),
+      integration_scheme(RUNGE_KUTTA_4)
+{
+    if(sampling_time <= 0)
+        throw std::runtime_error("sampling_time must be positive");
+    if(sim_per_cycle <= 0)
+        throw std::runtime_error("simulations_per_cycle must be positive");
+}
+
+BatchPropagation::~BatchPropagation()
+{
+}
+
+void BatchPropagation::setUWVParameters(const UWVParameters &uwv_parameters)
+{
+    dynamics.setUWVParameters(uwv_parameters);
+}
+
+void BatchPropagation::setIntegrationScheme(IntegrationScheme scheme)
+{
+    integration_scheme = scheme;
+}
+
+base::MatrixXd BatchPropagation::propagate(const base::MatrixXd &states, const base::Vector6d &control_input,
+        unsigned int n_threads) const
+{
+    if(size_t(states.rows()) != LINEAR_STATE_SIZE)
+        throw std::invalid_argument("BatchPropagation: states must be a 13 x N matrix");
+    if(states.hasNaN())
+        throw std::runtime_error("states have a NaN.");
+    if(control_input.hasNaN())
+        throw std::runtime_error("control input has a NaN.");
+
+    const size_t n = states.cols();
+    base::MatrixXd propagated(LINEAR_STATE_SIZE, n);
+    size_t n_blocks = (n + BLOCK_STATES - 1) / BLOCK_STATES;
+    parallelFor(n_blocks, n_threads, [&](size_t block)
+    {
+        size_t begin = block * BLOCK_STATES;
+        propagateBlock(states, control_input, begin, std::min(BLOCK_STATES, n - begin), propagated);
+    });
+    return propagated;
+}
+
+base::MatrixXd BatchPropagation::propagate(const base::MatrixXd &states, const base::Vector6d &control_input,
+        const base::VectorXd &mean_weights, const base::VectorXd &covariance_weights, BatchStatistics &statistics,
+        unsigned int n_threads) const
+{
+    base::MatrixXd propagated = propagate(states, control_input, n_threads);
+    statistics = calcStatistics(propagated, mean_weights, covariance_weights);
+    return propagated;
+}
+
+void BatchPropagation::propagateBlock(const base::MatrixXd &states, const base::Vector6d &control_input,
+        size_t begin, size_t n, base::MatrixXd &propagated) const
+{
+    const double *c, *b;
+    size_t n_stages;
+    getButcherTableau(integration_scheme, c, b, n_stages);
+
+    const double step = sampling_time / simulations_per_cycle;
+    base::MatrixXd block = states.middleCols(begin, n).transpose();
+    base::MatrixXd k = base::MatrixXd::Zero(n, LINEAR_STATE_SIZE);
+    base::MatrixXd increment(n, LINEAR_STATE_SIZE);
+    for(int i = 0; i < simulations_per_cycle; i++)
+    {
+        increment.setZero();
+        for(size_t stage = 0; stage < n_stages; stage++)
+        {
+            k = deriv(block + (step * c[stage]) * k, control_input);
+            increment += b[stage] * k;
+        }
+        block += step * increment;
+
+        // Brute force normalization of quaternions due the integration
+        Eigen::ArrayXd norm = block.middleCols(3, 4).rowwise().norm().array();
+        for(size_t j = 3; j < 7; j++)
+            block.col(j).array() /= norm;
+    }
+    propagated.middleCols(begin, n) = block.transpose();
+}
+
+base::MatrixXd BatchPropagation::deriv(const base::MatrixXd &block, const base::Vector6d &control_input) const
+{
+    const size_t n = block.rows();
+    base::MatrixXd derivative = base::MatrixXd::Zero(n, LINEAR_STATE_SIZE);
+    derivative.rightCols(6) = dynamics.calcAcceleration(control_input, block.rightCols(6), block.middleCols(3, 4));
+    if(simulator == DYNAMIC)
+        return derivative;
+
+    /** Position: R(q)*v = ((w^2 - |u|^2)*v + 2*(u.v)*u + 2*w*(u X v)) / |q|^2
+     *  with u the vector part and w the real part of q
+     */
+    const Eigen::ArrayXd w = block.col(6).array();
+    const Eigen::ArrayXd squared_vector = block.middleCols(3, 3).rowwise().squaredNorm().array();
+    const Eigen::ArrayXd squared_norm = squared_vector + w * w;
+    const Eigen::ArrayXd dot = (block.middleCols(3, 3).array() * block.middleCols(7, 3).array()).rowwise().sum();
+    const Eigen::ArrayXXd u_cross_v = crossRows(block, 3, block, 7);
+    for(size_t j = 0; j < 3; j++)
+        derivative.col(j) = (((w * w - squared_vector) * block.col(7 + j).array() +
+                2 * dot * block.col(3 + j).array() + 2 * w * u_cross_v.col(j)) / squared_norm).matrix();
+
+    /** Orientation: qdot = 1/2 * q * (0, w)
+     *  vector part: 1/2 * (q_w * w + q_u X w), real part: -1/2 * q_u.w
+     */
+    const Eigen::ArrayXXd u_cross_omega = crossRows(block, 3, block, 10);
+    for(size_t j = 0; j < 3; j++)
+        derivative.col(3 + j) = (0.5 * (w * block.col(10 + j).array() + u_cross_omega.col(j))).matrix();
+    derivative.col(6) = (-0.5 * (block.middleCols(3, 3).array() * block.middleCols(10, 3).array()).rowwise().sum()).matrix();
+    return derivative;
+}
+
+BatchStatistics BatchPropagation::calcStatistics(const base::MatrixXd &states, const base::VectorXd &mean_weights,
+        const base::VectorXd &covariance_weights)
+{
+    const size_t n = states.cols();
+    if(size_t(states.rows()) != LINEAR_STATE_SIZE || n == 0)
+        throw std::invalid_argument("BatchPropagation: states must be a 13 x N matrix with N > 0");
+    base::VectorXd weights = mean_weights.size() ? mean_weights : base::VectorXd::Constant(n, 1. / n);
+    base::VectorXd weights_covariance = covariance_weights.size() ? covariance_weights : weights;
+    if(size_t(weights.size()) != n || size_t(weights_covariance.size()) != n)
+        throw std::invalid_argument("BatchPropagation: there must be one weight per state");
+
+    BatchStatistics statistics;
+    statistics.mean = states * weights;
+
+    // Quaternions aligned with the first one, q and -q being the same orientation
+    const Eigen::Vector4d reference = states.block<4, 1>(3, 0);
+    Eigen::Vector4d orientation_sum = Eigen::Vector4d::Zero();
+    for(size_t i = 0; i < n; i++)
+    {
+        Eigen::Vector4d q = states.block<4, 1>(3, i);
+        orientation_sum += weights[i] * (q.dot(reference) < 0 ? -q : q);
+    }
+    base::Orientation mean_orientation;
+    mean_orientation.coeffs() = orientation_sum.normalized();
+    statistics.mean.segment<4>(3) = mean_orientation.coeffs();
+
+    statistics.covariance = base::MatrixXd::Zero(12, 12);
+    base::VectorXd error(12);
+    for(size_t i = 0; i < n; i++)
+    {
+        base::Orientation orientation;
+        orientation.coeffs() = states.block<4, 1>(3, i);
+        base::Orientation difference = mean_orientation.inverse() * orientation.normalized();
+        if(difference.w() < 0)
+            difference.coeffs() *= -1;
+        Eigen::AngleAxisd rotation(difference);
+
+        error << states.block<3, 1>(0, i) - statistics.mean.head<3>(),
+                rotation.angle() * rotation.axis(),
+                states.block<6, 1>(7, i) - statistics.mean.tail<6>();
+        statistics.covariance += weights_covariance[i] * error * error.transpose();
+    }
+    return statistics;
+}
+};
@@ -0,0 +1,123 @@
+#ifndef _BATCH_PROPAGATION_H_
+#define _BATCH_PROPAGATION_H_
+
+#include "BatchDynamics.hpp"
+#include "Linearization.hpp"
+
+namespace uwv_dynamic_model
+{
+/**
+ * Weighted mean and covariance of a set of states
+ */
+struct BatchStatistics
+{
+    /**
+     * Mean state vector (13, see toStateVector), with normalized mean orientation
+     */
+    base::VectorXd mean;
+
+    /**
+     * 12 x 12 covariance of the error state
+     * [position; rotation vector of mean^-1 * orientation; linear velocity; angular velocity]
+     */
+    base::MatrixXd covariance;
+};
+
+/**********************************************************
+ * Batch Propagation
+ * Propagation of many hypotheses of the state (particles, sigma points)
+ * through one sampling period with the same efforts and parameters.
+ *
+ * States are passed as 13 x N matrices, one column per hypothesis (see
+ * toStateVector). They are transposed by blocks, so that each state is a
+ * contiguous column of the block, and every integration stage is evaluated
+ * on whole columns with BatchDynamics. Blocks can be split between threads.
+ **********************************************************/
+class BatchPropagation
+{
+public:
+    /** Constructor
+     *
+     *  @param uwv_parameters shared by all the hypotheses
+     *  @param sim simulator, DYNAMIC keeps the pose constant
+     *  @param sampling_time
+     *  @param sim_per_cycle integration steps per sampling period
+     */
+    BatchPropagation(const UWVParameters &uwv_parameters, ModelSimulator sim = DYNAMIC_KINEMATIC,
+                     double sampling_time = 0.01, int sim_per_cycle = 10);
+
+    ~BatchPropagation();
+
+    /**
+     * Sets the general UWV parameters
+     * @param uwv_parameters
+     */
+    void setUWVParameters(const UWVParameters &uwv_parameters);
+
+    /** Set integration scheme
+     *
+     *  @param scheme, RUNGE_KUTTA_4 by default
+     */
+    void setIntegrationScheme(IntegrationScheme scheme);
+
+    /** Propagate all the states over one sampling period
+     *
+     *  Same result as ModelSimulation::sendEffort on each state when the
+     *  cycle is integrated: not for linear SIMPLE models simulated with the
+     *  exact discretization, nor with a current field, multi-rate steps or
+     *  an input delay or rate limit.
+     *  @param states 13 x N
+     *  @param control_input (forces and torques) in body frame
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return propagated states 13 x N
+     */
+    base::MatrixXd propagate(const base::MatrixXd &states, const base::Vector6d &control_input,
+                             unsigned int n_threads = 1) const;
+
+    /** Propagate all the states and compute their statistics
+     *
+     *  @param states 13 x N
+     *  @param control_input (forces and torques) in body frame
+     *  @param mean_weights see calcStatistics
+     *  @param covariance_weights see calcStatistics, e.g. sigma point weights with Wc0 != Wm0
+     *  @param statistics of the propagated states
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return propagated states 13 x N
+     */
+    base::MatrixXd propagate(const base::MatrixXd &states, const base::Vector6d &control_input,
+                             const base::VectorXd &mean_weights, const base::VectorXd &covariance_weights,
+                             BatchStatistics &statistics, unsigned int n_threads = 1) const;
+
+    /** Compute the weighted mean and covariance of states
+     *
+     *  The mean orientation is the normalized weighted sum of the quaternions,
+     *  aligned with the first one, suitable for concentrated distributions.
+     *  @param states 13 x N
+     *  @param mean_weights N weights of the mean. Empty for uniform weights.
+     *  @param covariance_weights N weights of the covariance (e.g. for sigma points).
+     *                            Empty for the mean weights.
+     *  @return statistics
+     */
+    static BatchStatistics calcStatistics(const base::MatrixXd &states, const base::VectorXd &mean_weights = base::VectorXd(),
+                                          const base::VectorXd &covariance_weights = base::VectorXd());
+
+private:
+    /**
+     * Propagate the columns [begin, begin+n) of states
+     */
+    void propagateBlock(const base::MatrixXd &states, const base::Vector6d &control_input,
+                        size_t begin, size_t n, base::MatrixXd &propagated) const;
+
+    /**
+     * State derivatives of a block, one row per state
+     */
+    base::MatrixXd deriv(const base::MatrixXd &block, const base::Vector6d &control_input) const;
+
+    BatchDynamics dynamics;
+    ModelSimulator simulator;
+    double sampling_time;
+    int simulations_per_cycle;
+    IntegrationScheme integration_scheme;
+};
+};
+#endif
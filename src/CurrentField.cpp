@@ -0,0 +1,182 @@
+#include "CurrentField.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+CurrentField::~CurrentField()
+{
+}
+
+base::Vector3d CurrentField::getVelocity(const base::Vector3d &position, double time) const
+{
+    CurrentFieldCache cache;
+    return getVelocity(position, time, cache);
+}
+
+UniformCurrentField::UniformCurrentField(const base::Vector3d &velocity)
+    : velocity(velocity)
+{
+}
+
+base::Vector3d UniformCurrentField::getVelocity(const base::Vector3d &/*position*/, double /*time*/,
+        CurrentFieldCache &/*cache*/) const
+{
+    return velocity;
+}
+
+TimeVaryingCurrentField::TimeVaryingCurrentField(const std::function<base::Vector3d(double)> &profile)
+    : profile(profile)
+{
+    if(!profile)
+        throw std::invalid_argument("TimeVaryingCurrentField: empty profile");
+}
+
+base::Vector3d TimeVaryingCurrentField::getVelocity(const base::Vector3d &/*position*/, double time,
+        CurrentFieldCache &/*cache*/) const
+{
+    return profile(time);
+}
+
+GridCurrentField::GridCurrentField(const base::Vector3d &origin, const base::Vector3d &spacing,
+        const Eigen::Vector3i &size, const std::vector<base::Vector3d> &velocities)
+    : origin(origin), spacing(spacing), size(size), velocities(velocities)
+{
+    checkGrid();
+}
+
+GridCurrentField::GridCurrentField(const std::string &path)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+        throw std::runtime_error("GridCurrentField: could not open " + path);
+
+    // Header keywords, then the velocities
+    const char *keywords[3] = {"origin", "spacing", "size"};
+    base::Vector3d header[3];
+    size_t n_header = 0;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string first;
+        if(!(stream >> first) || first[0] == '#')
+            continue;
+
+        if(n_header < 3)
+        {
+            base::Vector3d &values = header[n_header];
+            if(first != keywords[n_header] || !(stream >> values[0] >> values[1] >> values[2]))
+                throw std::runtime_error("GridCurrentField: " + path + " expected " + keywords[n_header]);
+            n_header++;
+            continue;
+        }
+
+        base::Vector3d velocity;
+        stream.seekg(0);
+        if(!(stream >> velocity[0] >> velocity[1] >> velocity[2]))
+            throw std::runtime_error("GridCurrentField: " + path + " invalid velocity: " + line);
+        velocities.push_back(velocity);
+    }
+    if(n_header < 3)
+        throw std::runtime_error("GridCurrentField: " + path + " is not a current grid file");
+
+    origin = header[0];
+    spacing = header[1];
+    for(int i = 0; i < 3; i++)
+    {
+        if(header[2][i] != std::floor(header[2][i]))
+            throw std::runtime_error("GridCurrentField: " + path + " size must be integer");
+        size[i] = header[2][i];
+    }
+    checkGrid();
+}
+
+void GridCurrentField::checkGrid() const
+{
+    if((size.array() < 1).any())
+        throw std::invalid_argument("GridCurrentField: the grid needs at least one point along each axis");
+    if((spacing.array() <= 0).any())
+        throw std::invalid_argument("GridCurrentField: spacing must be positive");
+    if(velocities.size() != (size_t)size[0] * size[1] * size[2])
+        throw std::invalid_argument("GridCurrentField: number of velocities does not match the grid size");
+    if(!origin.allFinite() || !spacing.allFinite())
+        throw std::invalid_argument("GridCurrentField: grid definition is not finite");
+    for(size_t i = 0; i < velocities.size(); i++)
+    {
+        if(!velocities[i].allFinite())
+            throw std::invalid_argument("GridCurrentField: velocities must be finite");
+    }
+}
+
+const base::Vector3d& GridCurrentField::getOrigin() const
+{
+    return origin;
+}
+
+const base::Vector3d& GridCurrentField::getSpacing() const
+{
+    return spacing;
+}
+
+const Eigen::Vector3i& GridCurrentField::getSize() const
+{
+    return size;
+}
+
+void GridCurrentField::loadCell(const base::Vector3d &position, CurrentFieldCache &cache) const
+{
+    // Lower grid point of the cell, and offset to the upper one along each axis
+    size_t index[3], offset[3];
+    const size_t stride[3] = {1, (size_t)size[0], (size_t)size[0] * size[1]};
+    for(int i = 0; i < 3; i++)
+    {
+        index[i] = 0;
+        if(size[i] > 1)
+            index[i] = std::min<size_t>((position[i] - origin[i]) / spacing[i], size[i] - 2);
+        offset[i] = size[i] > 1 ? stride[i] : 0;
+        cache.lower[i] = origin[i] + index[i] * spacing[i];
+        cache.upper[i] = cache.lower[i] + (size[i] > 1 ? spacing[i] : 0);
+    }
+
+    const size_t first = index[0] + index[1] * stride[1] + index[2] * stride[2];
+    for(int corner = 0; corner < 8; corner++)
+    {
+        cache.corners[corner] = velocities[first + (corner & 1 ? offset[0] : 0) +
+                (corner & 2 ? offset[1] : 0) + (corner & 4 ? offset[2] : 0)];
+    }
+    cache.valid = true;
+}
+
+base::Vector3d GridCurrentField::getVelocity(const base::Vector3d &position, double /*time*/,
+        CurrentFieldCache &vehicle_cache) const
+{
+    const base::Vector3d last = origin + spacing.cwiseProduct((size.array() - 1).cast<double>().matrix());
+    const base::Vector3d clamped = position.cwiseMax(origin).cwiseMin(last);
+
+    CurrentFieldCache local_cache;
+    CurrentFieldCache &cache = vehicle_cache.field.get() == this ? vehicle_cache : local_cache;
+    if(!cache.valid || (clamped.array() < cache.lower.array()).any() ||
+            (clamped.array() > cache.upper.array()).any())
+        loadCell(clamped, cache);
+
+    // Trilinear interpolation between the corners
+    base::Vector3d weight = base::Vector3d::Zero();
+    for(int i = 0; i < 3; i++)
+    {
+        if(cache.upper[i] > cache.lower[i])
+            weight[i] = (clamped[i] - cache.lower[i]) / (cache.upper[i] - cache.lower[i]);
+    }
+    const base::Vector3d *c = cache.corners;
+    base::Vector3d x00 = c[0] + weight[0] * (c[1] - c[0]);
+    base::Vector3d x10 = c[2] + weight[0] * (c[3] - c[2]);
+    base::Vector3d x01 = c[4] + weight[0] * (c[5] - c[4]);
+    base::Vector3d x11 = c[6] + weight[0] * (c[7] - c[6]);
+    base::Vector3d y0 = x00 + weight[1] * (x10 - x00);
+    base::Vector3d y1 = x01 + weight[1] * (x11 - x01);
+    return y0 + weight[2] * (y1 - y0);
+}
+};
@@ -0,0 +1,208 @@
+#ifndef _CURRENT_FIELD_H_
+#define _CURRENT_FIELD_H_
+
+#include "DataTypes.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+class CurrentField;
+
+/**
+ * Cell of a gridded field read by the last query, with the velocities at its
+ * corners. Keeping one per vehicle makes the following queries in the same
+ * cell independent of the grid memory.
+ */
+struct CurrentFieldCache
+{
+    CurrentFieldCache() : valid(false), lower(base::Vector3d::Zero()), upper(base::Vector3d::Zero()) {}
+
+    /** Cache bound to a field
+     *
+     *  @param field kept alive by the cache, so its cell cannot be mistaken for the one of another field
+     */
+    explicit CurrentFieldCache(const std::shared_ptr<const CurrentField> &field)
+        : field(field), valid(false), lower(base::Vector3d::Zero()), upper(base::Vector3d::Zero()) {}
+
+    /**
+     * Field the cache belongs to, the queries of other fields do not use it
+     */
+    std::shared_ptr<const CurrentField> field;
+
+    /**
+     * Whether a cell is loaded
+     */
+    bool valid;
+
+    /**
+     * Bounds of the cell in world frame
+     */
+    base::Vector3d lower;
+    base::Vector3d upper;
+
+    /**
+     * Velocities at the corners, x index varying fastest, then y, then z
+     */
+    base::Vector3d corners[8];
+};
+
+/**
+ * Water current seen by a vehicle during one integration step
+ */
+struct CurrentEnvironment
+{
+    CurrentEnvironment(CurrentFieldCache &cache, double time) : cache(cache), time(time) {}
+
+    /**
+     * Field of the vehicle, NULL for still water, and its cell cache
+     */
+    CurrentFieldCache &cache;
+
+    /**
+     * Time at which the field is evaluated
+     */
+    double time;
+};
+
+/**********************************************************
+ * Current Field
+ * Water velocity in world frame as a function of position and time.
+ * The current is irrotational and its acceleration is neglected.
+ * Fields are read only, one can be shared between vehicles and threads.
+ **********************************************************/
+class CurrentField
+{
+public:
+    virtual ~CurrentField();
+
+    /** Get the water velocity
+     *
+     *  @param position in world frame
+     *  @param time
+     *  @param cache of the vehicle, updated by gridded fields if it belongs to this field
+     *  @return velocity in world frame
+     */
+    virtual base::Vector3d getVelocity(const base::Vector3d &position, double time, CurrentFieldCache &cache) const = 0;
+
+    /** Get the water velocity, without cache
+     *
+     *  @param position in world frame
+     *  @param time
+     *  @return velocity in world frame
+     */
+    base::Vector3d getVelocity(const base::Vector3d &position, double time) const;
+};
+
+/**
+ * Same current everywhere and at all times
+ */
+class UniformCurrentField : public CurrentField
+{
+public:
+    /** Constructor
+     *
+     *  @param velocity in world frame
+     */
+    UniformCurrentField(const base::Vector3d &velocity);
+
+    base::Vector3d getVelocity(const base::Vector3d &position, double time, CurrentFieldCache &cache) const;
+    using CurrentField::getVelocity;
+
+private:
+    base::Vector3d velocity;
+};
+
+/**
+ * Current uniform in space, varying in time (tides, ...)
+ */
+class TimeVaryingCurrentField : public CurrentField
+{
+public:
+    /** Constructor
+     *
+     *  @param profile velocity in world frame as a function of time
+     */
+    TimeVaryingCurrentField(const std::function<base::Vector3d(double)> &profile);
+
+    base::Vector3d getVelocity(const base::Vector3d &position, double time, CurrentFieldCache &cache) const;
+    using CurrentField::getVelocity;
+
+private:
+    std::function<base::Vector3d(double)> profile;
+};
+
+/**
+ * Constant current sampled on a regular 3D grid, trilinearly interpolated.
+ * Positions outside of the grid get the velocity of the closest point of the grid.
+ *
+ * File format (text, lines starting with # are comments):
+ *  origin x y z
+ *  spacing dx dy dz
+ *  size nx ny nz
+ * followed by the nx * ny * nz velocities "vx vy vz", x index varying
+ * fastest, then y, then z.
+ */
+class GridCurrentField : public CurrentField
+{
+public:
+    /** Constructor
+     *
+     *  @param origin position of the first grid point in world frame
+     *  @param spacing distance between grid points along each axis
+     *  @param size number of grid points along each axis
+     *  @param velocities nx * ny * nz velocities in world frame, x index varying fastest
+     */
+    GridCurrentField(const base::Vector3d &origin, const base::Vector3d &spacing, const Eigen::Vector3i &size,
+                     const std::vector<base::Vector3d> &velocities);
+
+    /** Load a grid file
+     *
+     *  @param path of the file
+     */
+    GridCurrentField(const std::string &path);
+
+    /** Get the water velocity
+     *
+     *  The corners of the cell containing the position are copied in the
+     *  cache, so the grid is only read when the vehicle changes cell. A
+     *  cache belonging to another field is left untouched.
+     *  @param position in world frame
+     *  @param time, unused
+     *  @param cache of the vehicle
+     *  @return velocity in world frame
+     */
+    base::Vector3d getVelocity(const base::Vector3d &position, double time, CurrentFieldCache &cache) const;
+    using CurrentField::getVelocity;
+
+    /** Get the grid definition
+     *
+     *  @return position of the first grid point, distance between grid points
+     *  and number of grid points along each axis
+     */
+    const base::Vector3d& getOrigin() const;
+    const base::Vector3d& getSpacing() const;
+    const Eigen::Vector3i& getSize() const;
+
+private:
+    /** Check the grid definition
+     *
+     */
+    void checkGrid() const;
+
+    /** Copy the cell containing a position in the cache
+     *
+     *  @param position clamped to the grid
+     *  @param cache
+     */
+    void loadCell(const base::Vector3d &position, CurrentFieldCache &cache) const;
+
+    base::Vector3d origin;
+    base::Vector3d spacing;
+    Eigen::Vector3i size;
+    std::vector<base::Vector3d> velocities;
+};
+};
+#endif
@@ -62,6 +62,24 @@ enum ModelSimulator
     DYNAMIC_KINEMATIC
 };
 
+/** Define which explicit scheme integrates the states.
+ *
+ * Euler:
+ * First order, one derivative evaluation per step.
+ *
+ * Heun:
+ * Second order, two derivative evaluations per step.
+ *
+ * Runge_Kutta_4:
+ * Classical 4th order Runge-Kutta, four derivative evaluations per step.
+ */
+enum IntegrationScheme
+{
+    EULER,
+    HEUN,
+    RUNGE_KUTTA_4
+};
+
 /**
  * Structure that contains all the necessary information for simulating the motion model
  */
@@ -13,12 +13,47 @@ DynamicKinematicSimulator::DynamicKinematicSimulator( double integration_step):
 DynamicKinematicSimulator::~DynamicKinematicSimulator()
 {}
 
-PoseVelocityState DynamicKinematicSimulator::poseDeriv(const PoseVelocityState &current_states)
+PoseVelocityState DynamicKinematicSimulator::poseDeriv(const PoseVelocityState &current_states, const EvaluationContext &context) const
 {
     PoseVelocityState deriv;
-    deriv.position = kinematic_model.calcPoseDeriv(current_states.linear_velocity, current_states.orientation);
+    deriv.position = kinematic_model.calcPoseDeriv(current_states.linear_velocity, context);
     deriv.orientation = kinematic_model.calcOrientationDeriv(current_states.angular_velocity, current_states.orientation);
     return deriv;
 }
 
+base::MatrixXd DynamicKinematicSimulator::sensitivityDeriv(const PoseVelocityState &current_states,
+        const base::Vector6d &control_input, const base::MatrixXd &sensitivity) const
+{
+    base::MatrixXd derivative = DynamicSimulator::sensitivityDeriv(current_states, control_input, sensitivity);
+    const EvaluationContext context(current_states.orientation);
+    const base::Vector3d u = current_states.orientation.vec();
+    const double w = current_states.orientation.w();
+    const base::Vector3d &angular_velocity = current_states.angular_velocity;
+
+    // Position: d(R*v)
+    derivative.topRows(3) = context.rotation * sensitivity.middleRows(7, 3) +
+            calcRotationJacobian(current_states.orientation, current_states.linear_velocity) * sensitivity.middleRows(3, 4);
+
+    /** Orientation: qdot = 1/2 * q * (0, w)
+     *  vector part: 1/2 * (q_w * w + q_u X w), real part: -1/2 * q_u.w
+     */
+    base::Matrix3d skew_angular;
+    skew_angular << 0, -angular_velocity[2], angular_velocity[1],
+                    angular_velocity[2], 0, -angular_velocity[0],
+                   -angular_velocity[1], angular_velocity[0], 0;
+    base::Matrix3d skew_u;
+    skew_u << 0, -u[2], u[1],
+              u[2], 0, -u[0],
+             -u[1], u[0], 0;
+    Eigen::Matrix4d orientation_jacobian;
+    orientation_jacobian << -0.5 * skew_angular, 0.5 * angular_velocity,
+                            -0.5 * angular_velocity.transpose(), 0;
+    Eigen::Matrix<double, 4, 3> angular_velocity_jacobian;
+    angular_velocity_jacobian << 0.5 * (w * base::Matrix3d::Identity() + skew_u),
+                                 -0.5 * u.transpose();
+    derivative.middleRows(3, 4) = orientation_jacobian * sensitivity.middleRows(3, 4) +
+            angular_velocity_jacobian * sensitivity.bottomRows(3);
+    return derivative;
+}
+
 };
@@ -23,8 +23,20 @@ public:
      * Compute pose derivatives (velocities in world frame)
      *
      * @param current_states of pose and velocities
+     * @param context frame conversions of the current orientation
      */
-    PoseVelocityState poseDeriv(const PoseVelocityState &current_states);
+    PoseVelocityState poseDeriv(const PoseVelocityState &current_states, const EvaluationContext &context) const;
+
+    /** Overrides
+     *  Compute derivative of the sensitivity matrix, pose and velocity rows
+     *
+     *  @param current_states
+     *  @param forces & torques
+     *  @param sensitivity 13 x P
+     *  @return 13 x P derivative
+     */
+    base::MatrixXd sensitivityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                    const base::MatrixXd &sensitivity) const;
 
 private:
     /**
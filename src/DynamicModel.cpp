@@ -1,9 +1,65 @@
 #include "DynamicModel.hpp"
+#include "Profiling.hpp"
 #include <base-logging/Logging.hpp>
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <utility>
 
 namespace uwv_dynamic_model
 {
+namespace
+{
+/**
+ * Skew-symmetric matrix of the cross product, S(a)*b = a X b
+ */
+base::Matrix3d skew(const base::Vector3d &a)
+{
+    base::Matrix3d s;
+    s << 0, -a[2], a[1],
+         a[2], 0, -a[0],
+        -a[1], a[0], 0;
+    return s;
+}
+
+/** Newton iterations with backtracking on the residual norm
+ *
+ *  function(x, residual, jacobian) evaluates both at x. Steps are the minimum
+ *  norm solution, so directions that do not change the residual are kept.
+ *  @return true if the residual norm falls below tolerance
+ */
+template<class Function>
+bool solveNewton(base::Vector6d &x, const Function &function, double tolerance, unsigned int max_iterations)
+{
+    base::Vector6d residual;
+    base::Matrix6d jacobian;
+    function(x, residual, jacobian);
+    for(unsigned int i = 0; i < max_iterations && residual.norm() > tolerance; i++)
+    {
+        Eigen::JacobiSVD<base::MatrixXd> svd(jacobian, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        base::Vector6d step = svd.solve(-residual);
+
+        base::Vector6d trial;
+        base::Vector6d trial_residual;
+        base::Matrix6d trial_jacobian;
+        double alpha = 1;
+        do
+        {
+            trial = x + alpha * step;
+            function(trial, trial_residual, trial_jacobian);
+            alpha /= 2;
+        } while(!(trial_residual.norm() < residual.norm()) && alpha > 1e-6);
+
+        if(!(trial_residual.norm() < residual.norm()))
+            return false;
+        x = trial;
+        residual = trial_residual;
+        jacobian = trial_jacobian;
+    }
+    return residual.norm() <= tolerance;
+}
+}
+
 DynamicModel::DynamicModel()
 {
     // uwv model parameters
@@ -16,6 +72,11 @@ DynamicModel::~DynamicModel()
 }
 
 base::Vector6d DynamicModel::calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity, const base::Orientation &orientation) const
+{
+    return calcAcceleration(control_input, velocity, EvaluationContext(orientation));
+}
+
+base::Vector6d DynamicModel::calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity, const EvaluationContext &context) const
 {
     // Check inputs
     checkControlInput(control_input);
@@ -24,12 +85,27 @@ base::Vector6d DynamicModel::calcAcceleration(const base::Vector6d &control_inpu
     // Calculating the acceleration based on all the hydrodynamics effects
     base::Vector6d acceleration = base::Vector6d::Zero();
 
-    acceleration = control_input - calcGravityBuoyancy(orientation, uwv_parameters);
+    acceleration = control_input - calcGravityBuoyancy(context, uwv_parameters);
     acceleration -= calcDampingAndCoriolisEffect(uwv_parameters, velocity);
+
+    UWV_PROFILE_SCOPE(PROFILE_INVERSE_INERTIA_PRODUCT);
     return invert_inertia_matrix*acceleration;
 }
 
+base::Vector6d DynamicModel::calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity,
+        const base::Vector3d &current_velocity, const EvaluationContext &context) const
+{
+    base::Vector6d relative_velocity = velocity;
+    relative_velocity.head<3>() -= context.toBody(current_velocity);
+    return calcAcceleration(control_input, relative_velocity, context);
+}
+
 base::Vector6d DynamicModel::calcEfforts(const base::Vector6d& acceleration, const base::Vector6d& velocity, const base::Orientation& orientation) const
+{
+    return calcEfforts(acceleration, velocity, EvaluationContext(orientation));
+}
+
+base::Vector6d DynamicModel::calcEfforts(const base::Vector6d& acceleration, const base::Vector6d& velocity, const EvaluationContext &context) const
 {
     // Check inputs
     checkAcceleration(acceleration);
@@ -38,11 +114,210 @@ base::Vector6d DynamicModel::calcEfforts(const base::Vector6d& acceleration, con
     // Calculating the efforts given the current state based on all the hydrodynamics effects
     base::Vector6d efforts = base::Vector6d::Zero();
 
-    efforts = uwv_parameters.inertia_matrix * acceleration + calcGravityBuoyancy(orientation, uwv_parameters);
+    efforts = uwv_parameters.inertia_matrix * acceleration + calcGravityBuoyancy(context, uwv_parameters);
     efforts += calcDampingAndCoriolisEffect(uwv_parameters, velocity);
     return efforts;
 }
 
+base::Matrix6d DynamicModel::calcVelocityJacobian(const base::Vector6d &velocity) const
+{
+    checkVelocity(velocity);
+    const base::Matrix6d &inertia = uwv_parameters.inertia_matrix;
+    const std::vector<base::Matrix6d> &damping = uwv_parameters.damping_matrices;
+    base::Matrix6d jacobian = base::Matrix6d::Zero();
+
+    switch(uwv_parameters.model_type)
+    {
+    case COMPLEX:
+        // d(sum(Di * |vi|) * v)/dv = sum(Di * |vi|) + [sign(vi) * Di * v]_i
+        for(size_t i = 0; i < 6; i++)
+        {
+            jacobian += damping[i] * std::abs(velocity[i]);
+            if(velocity[i] != 0)
+                jacobian.col(i) += (velocity[i] > 0 ? 1 : -1) * damping[i] * velocity;
+        }
+        break;
+    case SIMPLE:
+    case INTERMEDIATE:
+        // d(linDamping*v + quadDamping*|v|*v)/dv = linDamping + quadDamping*2|v|
+        jacobian = damping[0] + damping[1] * (2 * velocity.cwiseAbs()).asDiagonal();
+        break;
+    }
+
+    if(uwv_parameters.model_type != SIMPLE)
+    {
+        /** Coriolis effect = -[p_l X w; p_l X v_l + p_a X w], p = M*v
+         *  d(a X b) = S(a)*db - S(b)*da
+         */
+        const base::Vector3d linear = velocity.head<3>();
+        const base::Vector3d angular = velocity.tail<3>();
+        const base::Vector6d prod = inertia * velocity;
+        base::Matrix6d coriolis;
+        coriolis.topRows<3>() = -skew(angular) * inertia.topRows<3>();
+        coriolis.topRightCorner<3, 3>() += skew(prod.head<3>());
+        coriolis.bottomRows<3>() = -skew(linear) * inertia.topRows<3>() - skew(angular) * inertia.bottomRows<3>();
+        coriolis.bottomLeftCorner<3, 3>() += skew(prod.head<3>());
+        coriolis.bottomRightCorner<3, 3>() += skew(prod.tail<3>());
+        jacobian -= coriolis;
+    }
+    return jacobian;
+}
+
+base::Matrix6d DynamicModel::calcAccelerationVelocityJacobian(const base::Vector6d &velocity) const
+{
+    return -invert_inertia_matrix * calcVelocityJacobian(velocity);
+}
+
+Eigen::Matrix<double, 6, 3> DynamicModel::calcAccelerationOrientationJacobian() const
+{
+    // gravityBuoyancy = [R^T * e3 * (W-B); (cg*W - cb*B) X R^T * e3]
+    Eigen::Matrix<double, 6, 3> restoring;
+    restoring.topRows<3>() = base::Matrix3d::Identity() * (uwv_parameters.weight - uwv_parameters.buoyancy);
+    restoring.bottomRows<3>() = skew(uwv_parameters.distance_body2centerofgravity * uwv_parameters.weight -
+            uwv_parameters.distance_body2centerofbuoyancy * uwv_parameters.buoyancy);
+    return -invert_inertia_matrix * restoring;
+}
+
+size_t DynamicModel::getSensitivityParameterCount() const
+{
+    return 6 * uwv_parameters.damping_matrices.size() + 8;
+}
+
+base::MatrixXd DynamicModel::calcAccelerationParameterJacobian(const base::Vector6d &velocity, const EvaluationContext &context) const
+{
+    checkVelocity(velocity);
+    const size_t n_damping = uwv_parameters.damping_matrices.size();
+    base::MatrixXd efforts = base::MatrixXd::Zero(6, getSensitivityParameterCount());
+
+    // Diagonal entries of the damping matrices
+    for(size_t k = 0; k < n_damping; k++)
+    {
+        for(size_t i = 0; i < 6; i++)
+        {
+            double factor;
+            if(uwv_parameters.model_type == COMPLEX)
+                factor = std::abs(velocity[k]);
+            else
+                factor = k == 0 ? 1 : std::abs(velocity[i]);
+            efforts(i, 6 * k + i) = factor * velocity[i];
+        }
+    }
+
+    // Weight, buoyancy, center of gravity and center of buoyancy
+    const base::Vector3d world_z = context.worldZInBody();
+    const size_t offset = 6 * n_damping;
+    efforts.block<3, 1>(0, offset) = world_z;
+    efforts.block<3, 1>(3, offset) = uwv_parameters.distance_body2centerofgravity.cross(world_z);
+    efforts.block<3, 1>(0, offset + 1) = -world_z;
+    efforts.block<3, 1>(3, offset + 1) = -uwv_parameters.distance_body2centerofbuoyancy.cross(world_z);
+    for(size_t m = 0; m < 3; m++)
+    {
+        base::Vector3d moment = base::Vector3d::Unit(m).cross(world_z);
+        efforts.block<3, 1>(3, offset + 2 + m) = moment * uwv_parameters.weight;
+        efforts.block<3, 1>(3, offset + 5 + m) = -moment * uwv_parameters.buoyancy;
+    }
+    return -invert_inertia_matrix * efforts;
+}
+
+base::Vector6d DynamicModel::calcSteadyStateEfforts(const base::Vector6d &velocity, const base::Orientation &orientation) const
+{
+    return calcEfforts(base::Vector6d::Zero(), velocity, orientation);
+}
+
+base::Vector6d DynamicModel::calcSteadyStateVelocity(const base::Vector6d &efforts, const base::Orientation &orientation,
+        const base::Vector6d &initial_velocity, double tolerance, unsigned int max_iterations) const
+{
+    checkControlInput(efforts);
+    const EvaluationContext context(orientation);
+
+    base::Vector6d velocity = initial_velocity;
+    if(velocity.isZero())
+    {
+        // The quadratic damping has no slope at rest
+        Eigen::JacobiSVD<base::MatrixXd> svd(calcVelocityJacobian(base::Vector6d::Ones()), Eigen::ComputeThinU | Eigen::ComputeThinV);
+        velocity = svd.solve(efforts - calcGravityBuoyancy(context, uwv_parameters));
+    }
+
+    bool converged = solveNewton(velocity, [&](const base::Vector6d &v, base::Vector6d &residual, base::Matrix6d &jacobian)
+    {
+        residual = calcEfforts(base::Vector6d::Zero(), v, context) - efforts;
+        jacobian = calcVelocityJacobian(v);
+    }, tolerance * (1 + efforts.norm()), max_iterations);
+
+    if(!converged)
+        throw std::runtime_error("DynamicModel calcSteadyStateVelocity: no steady state found for the given efforts");
+    return velocity;
+}
+
+PoseVelocityState DynamicModel::calcTrim(const base::Vector6d &efforts, const PoseVelocityState &initial_state,
+        double tolerance, unsigned int max_iterations) const
+{
+    checkControlInput(efforts);
+    const double weight = uwv_parameters.weight;
+    const double buoyancy = uwv_parameters.buoyancy;
+    const base::Vector3d moment = uwv_parameters.distance_body2centerofgravity * weight -
+            uwv_parameters.distance_body2centerofbuoyancy * buoyancy;
+
+    /** Unknowns x = [linear velocity; roll; pitch; yaw rate]
+     *  With null yaw, R^T*e3 = [-sin(pitch); sin(roll)*cos(pitch); cos(roll)*cos(pitch)]
+     *  and the body-frame angular velocity is R^T*e3*yaw_rate.
+     */
+    base::Vector3d world_z = EvaluationContext(initial_state.orientation).worldZInBody();
+    base::Vector6d x;
+    x << initial_state.linear_velocity,
+            std::atan2(world_z[1], world_z[2]),
+            -std::asin(std::max(-1., std::min(1., world_z[0]))),
+            world_z.dot(initial_state.angular_velocity);
+
+    if(initial_state.linear_velocity.isZero() && x[5] == 0)
+    {
+        // The quadratic damping has no slope at rest
+        base::Vector6d restoring;
+        restoring << world_z * (weight - buoyancy), moment.cross(world_z);
+        Eigen::JacobiSVD<base::MatrixXd> svd(calcVelocityJacobian(base::Vector6d::Ones()), Eigen::ComputeThinU | Eigen::ComputeThinV);
+        base::Vector6d velocity = svd.solve(efforts - restoring);
+        x.head<3>() = velocity.head<3>();
+        x[5] = world_z.dot(velocity.tail<3>());
+    }
+
+    bool converged = solveNewton(x, [&](const base::Vector6d &x, base::Vector6d &residual, base::Matrix6d &jacobian)
+    {
+        double sr = std::sin(x[3]), cr = std::cos(x[3]);
+        double sp = std::sin(x[4]), cp = std::cos(x[4]);
+        base::Vector3d z(-sp, sr * cp, cr * cp);
+        base::Vector3d dz_roll(0, cr * cp, -sr * cp);
+        base::Vector3d dz_pitch(-cp, -sr * sp, -cr * sp);
+
+        base::Vector6d velocity;
+        velocity << x.head<3>(), z * x[5];
+        base::Vector6d restoring;
+        restoring << z * (weight - buoyancy), moment.cross(z);
+        residual = calcDampingAndCoriolisEffect(uwv_parameters, velocity) + restoring - efforts;
+
+        // d(velocity)/dx
+        base::Matrix6d dvelocity = base::Matrix6d::Zero();
+        dvelocity.topLeftCorner<3, 3>() = base::Matrix3d::Identity();
+        dvelocity.block<3, 1>(3, 3) = dz_roll * x[5];
+        dvelocity.block<3, 1>(3, 4) = dz_pitch * x[5];
+        dvelocity.block<3, 1>(3, 5) = z;
+        jacobian = calcVelocityJacobian(velocity) * dvelocity;
+        jacobian.block<3, 1>(0, 3) += dz_roll * (weight - buoyancy);
+        jacobian.block<3, 1>(0, 4) += dz_pitch * (weight - buoyancy);
+        jacobian.block<3, 1>(3, 3) += moment.cross(dz_roll);
+        jacobian.block<3, 1>(3, 4) += moment.cross(dz_pitch);
+    }, tolerance * (1 + efforts.norm()), max_iterations);
+
+    if(!converged)
+        throw std::runtime_error("DynamicModel calcTrim: no trim state found for the given efforts");
+
+    PoseVelocityState state;
+    state.orientation = base::Orientation(Eigen::AngleAxisd(x[4], base::Vector3d::UnitY()) *
+            Eigen::AngleAxisd(x[3], base::Vector3d::UnitX()));
+    state.linear_velocity = x.head<3>();
+    state.angular_velocity = EvaluationContext(state.orientation).worldZInBody() * x[5];
+    return state;
+}
+
 void DynamicModel::setUWVParameters(const UWVParameters &parameters)
 {
     // Checks if there is any parameter inconsistency
@@ -56,12 +331,24 @@ UWVParameters DynamicModel::getUWVParameters(void) const
     return uwv_parameters;
 }
 
+ModelType DynamicModel::getModelType(void) const
+{
+    return uwv_parameters.model_type;
+}
+
+void DynamicModel::swap(DynamicModel &model)
+{
+    std::swap(uwv_parameters, model.uwv_parameters);
+    std::swap(invert_inertia_matrix, model.invert_inertia_matrix);
+}
+
 base::Matrix6d DynamicModel::calcInvInertiaMatrix(const base::Matrix6d &inertia_matrix) const
 {
     /**
      * M * M^(-1) = I
      * A*x = b
      */
+    UWV_PROFILE_SCOPE(PROFILE_INERTIA_INVERSION);
     Eigen::JacobiSVD<base::MatrixXd> svd(inertia_matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
     return svd.solve(base::Matrix6d::Identity());
 }
@@ -82,6 +369,7 @@ base::Vector6d DynamicModel::calcCoriolisEffect(const base::Matrix6d &inertia_ma
      * Cross product:
      *      J(v.head(3)) * v.tail(3) = v.head(3) X v.tail(3)
      */
+    UWV_PROFILE_SCOPE(PROFILE_CORIOLIS);
 
     base::Vector6d coriloisEffect;
     base::Vector6d prod = inertia_matrix * velocity;
@@ -115,6 +403,7 @@ base::Vector6d DynamicModel::caclGeneralQuadDamping( const std::vector<base::Mat
      *  damping effect = sum(Di * |vi|) * v, i=1...6
      *  D = quadDampMatrix; v = velocity
      */
+    UWV_PROFILE_SCOPE(PROFILE_GENERAL_QUAD_DAMPING);
     if(quad_damp_matrices.size() != 6)
         throw std::runtime_error("quadDampMatrices does not have 6 elements.");
 
@@ -131,6 +420,7 @@ base::Vector6d DynamicModel::caclSimpleDamping( const std::vector<base::Matrix6d
      *  Based on Fossen[1994]
      *  damping effect = quadDampingMatrix*|vi|*v + linDampingMatrix*v
      */
+    UWV_PROFILE_SCOPE(PROFILE_SIMPLE_DAMPING);
     if(damp_matrices.size() != 2)
         throw std::runtime_error("dampMatrices does not have 2 elements.");
     return calcLinDamping(damp_matrices[0], velocity) + calcQuadDamping(damp_matrices[1], velocity);
@@ -146,12 +436,12 @@ base::Vector6d DynamicModel::calcQuadDamping( const base::Matrix6d &quad_damp_ma
     return quad_damp_matrix * velocity.cwiseAbs().asDiagonal() * velocity;
 }
 
-base::Vector6d DynamicModel::calcGravityBuoyancy(const base::Orientation& orientation, const UWVParameters &uwv_parameters) const
+base::Vector6d DynamicModel::calcGravityBuoyancy(const EvaluationContext &context, const UWVParameters &uwv_parameters) const
 {
-    return calcGravityBuoyancy(orientation, uwv_parameters.weight, uwv_parameters.buoyancy, uwv_parameters.distance_body2centerofgravity, uwv_parameters.distance_body2centerofbuoyancy);
+    return calcGravityBuoyancy(context, uwv_parameters.weight, uwv_parameters.buoyancy, uwv_parameters.distance_body2centerofgravity, uwv_parameters.distance_body2centerofbuoyancy);
 }
 
-base::Vector6d DynamicModel::calcGravityBuoyancy( const base::Orientation& orientation,
+base::Vector6d DynamicModel::calcGravityBuoyancy( const EvaluationContext &context,
         const double& weight, const double& bouyancy,
         const base::Vector3d& cg, const base::Vector3d& cb) const
 {
@@ -163,9 +453,11 @@ base::Vector6d DynamicModel::calcGravityBuoyancy( const base::Orientation& orien
      *
      *  In Rock framework, positive z is pointing up, in marine/underwater literature positive z is pointing down.
      */
+    UWV_PROFILE_SCOPE(PROFILE_GRAVITY_BUOYANCY);
+    base::Vector3d world_z = context.worldZInBody();
     base::Vector6d gravityEffect;
-    gravityEffect << orientation.inverse() * Eigen::Vector3d(0, 0, (weight-bouyancy)),
-            (cg*weight - cb*bouyancy).cross(orientation.inverse() * Eigen::Vector3d(0, 0, 1));
+    gravityEffect << world_z * (weight-bouyancy),
+            (cg*weight - cb*bouyancy).cross(world_z);
     return gravityEffect;
 }
 
@@ -2,6 +2,7 @@
 #define _DYNAMIC_MODEL_H_
 
 #include "DataTypes.hpp"
+#include "EvaluationContext.hpp"
 
 namespace uwv_dynamic_model
 {
@@ -21,6 +22,30 @@ public:
      */
     base::Vector6d calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity, const base::Orientation &orientation) const;
 
+    /** Compute Acceleration
+     *
+     *  @param control input (forces and torques) in body frame.
+     *  @param actual linear/angular velocity in body frame.
+     *  @param context frame conversions of the actual orientation
+     *  @return linear/angular acceleration in body frame
+     */
+    base::Vector6d calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity, const EvaluationContext &context) const;
+
+    /** Compute Acceleration in a water current
+     *
+     *  Damping and Coriolis act on the velocity relative to the water. The
+     *  current is irrotational and its acceleration is neglected, so the rigid
+     *  body and added mass terms are both those of the relative velocity.
+     *  @param control input (forces and torques) in body frame.
+     *  @param actual linear/angular velocity in body frame.
+     *  @param current_velocity water velocity in world frame
+     *  @param context frame conversions of the actual orientation
+     *  @return derivative of the relative linear/angular velocity in body
+     *  frame, see DynamicSimulator::velocityDeriv for the one of the velocity
+     */
+    base::Vector6d calcAcceleration(const base::Vector6d &control_input, const base::Vector6d &velocity,
+                                    const base::Vector3d &current_velocity, const EvaluationContext &context) const;
+
     /** Compute efforts. Inverse of compute acceleration.
      *
      *  @param acceleration linear/angular acceleration in body frame
@@ -30,6 +55,93 @@ public:
      */
     base::Vector6d calcEfforts(const base::Vector6d &acceleration, const base::Vector6d &velocity, const base::Orientation &orientation) const;
 
+    /** Compute efforts. Inverse of compute acceleration.
+     *
+     *  @param acceleration linear/angular acceleration in body frame
+     *  @param actual linear/angular velocity in body frame
+     *  @param context frame conversions of the actual orientation
+     *  @return (forces and torques) in body frame
+     */
+    base::Vector6d calcEfforts(const base::Vector6d &acceleration, const base::Vector6d &velocity, const EvaluationContext &context) const;
+
+    /** Compute the Jacobian of the velocity dependent efforts
+     *
+     *  Derivative of the damping and Coriolis efforts with respect to the velocity.
+     *  The Jacobian of the acceleration is -M^(-1) times this matrix.
+     *  @param velocity linear/angular velocity in body frame
+     *  @return d(efforts)/d(velocity)
+     */
+    base::Matrix6d calcVelocityJacobian(const base::Vector6d &velocity) const;
+
+    /** Compute the Jacobian of the acceleration with respect to the velocity
+     *
+     *  @param velocity linear/angular velocity in body frame
+     *  @return -M^(-1) * calcVelocityJacobian(velocity)
+     */
+    base::Matrix6d calcAccelerationVelocityJacobian(const base::Vector6d &velocity) const;
+
+    /** Compute the Jacobian of the acceleration with respect to the world z axis in body frame
+     *
+     *  The restoring efforts depend on the orientation through R^T*e3 only.
+     *  @return 6 x 3 derivative of the acceleration with respect to R^T*e3
+     */
+    Eigen::Matrix<double, 6, 3> calcAccelerationOrientationJacobian() const;
+
+    /** Get the number of parameters of the sensitivity analysis
+     *
+     *  The parameters are, in order: the diagonal of each damping matrix,
+     *  the weight, the buoyancy, the center of gravity and the center of buoyancy.
+     *  @return 6 * number of damping matrices + 8
+     */
+    size_t getSensitivityParameterCount() const;
+
+    /** Compute the Jacobian of the acceleration with respect to the parameters
+     *
+     *  See getSensitivityParameterCount for the parameters.
+     *  @param velocity linear/angular velocity in body frame
+     *  @param context frame conversions of the actual orientation
+     *  @return 6 x getSensitivityParameterCount() matrix
+     */
+    base::MatrixXd calcAccelerationParameterJacobian(const base::Vector6d &velocity, const EvaluationContext &context) const;
+
+    /** Compute the efforts keeping a constant velocity. Inverse of calcSteadyStateVelocity.
+     *
+     *  @param velocity linear/angular velocity in body frame
+     *  @param orientation
+     *  @return (forces and torques) in body frame
+     */
+    base::Vector6d calcSteadyStateEfforts(const base::Vector6d &velocity, const base::Orientation &orientation) const;
+
+    /** Compute the velocity with null acceleration for constant efforts and orientation
+     *
+     *  Newton iterations on calcEfforts(0, velocity, orientation) = efforts.
+     *  @param efforts (forces and torques) in body frame
+     *  @param orientation
+     *  @param initial_velocity initial guess. Zero for a guess based on the damping at unit velocity.
+     *  @param tolerance on the effort residual, relative to the norm of the efforts
+     *  @param max_iterations
+     *  @return linear/angular velocity in body frame
+     */
+    base::Vector6d calcSteadyStateVelocity(const base::Vector6d &efforts, const base::Orientation &orientation,
+            const base::Vector6d &initial_velocity = base::Vector6d::Zero(),
+            double tolerance = 1e-10, unsigned int max_iterations = 50) const;
+
+    /** Compute the trim state for constant efforts
+     *
+     *  Finds the body-frame linear velocity, roll, pitch and yaw rate (angular
+     *  velocity around the world z axis) with null acceleration, i.e. the
+     *  steady straight or turning motion reached under constant efforts.
+     *  Directions the efforts do not determine (e.g. roll and pitch of a
+     *  vehicle without restoring torque) are kept from the initial state.
+     *  @param efforts (forces and torques) in body frame
+     *  @param initial_state initial guess. Yaw and position are ignored.
+     *  @param tolerance on the effort residual, relative to the norm of the efforts
+     *  @param max_iterations
+     *  @return trim state, with null yaw and position
+     */
+    PoseVelocityState calcTrim(const base::Vector6d &efforts, const PoseVelocityState &initial_state = PoseVelocityState(),
+            double tolerance = 1e-10, unsigned int max_iterations = 50) const;
+
     /**
      * Sets the general UWV parameters
      * @param uwvParamaters - Structures containing the uwv parameters
@@ -42,6 +154,19 @@ public:
      */
     UWVParameters getUWVParameters(void) const;
 
+    /**
+     * Gets the model type, without copying the parameters
+     * @return - Model type
+     */
+    ModelType getModelType(void) const;
+
+    /**
+     * Exchange parameters and precomputed terms with another model.
+     * Does not allocate memory.
+     * @param model
+     */
+    void swap(DynamicModel &model);
+
 private:
 
     /**
@@ -107,22 +232,22 @@ private:
     base::Vector6d calcQuadDamping( const base::Matrix6d &quad_damp_matrix, const base::Vector6d &velocity) const;
 
     /** Compute gravity and bouyancy terms
-     * @param current orientation
+     * @param context frame conversions of the current orientation
      * @param uwv_parametes
      * @return vecto ofr forces and torques
      */
-    base::Vector6d calcGravityBuoyancy(const base::Orientation& orientation, const UWVParameters &uwv_parameters) const;
+    base::Vector6d calcGravityBuoyancy(const EvaluationContext &context, const UWVParameters &uwv_parameters) const;
 
     /** Compute gravity and buoyancy terms
      *
-     * @param quaternion orientation
+     * @param context frame conversions of the current orientation
      * @param weight [N]
      * @param buoyancy [N]
      * @param vector center of gravity
      * @param vector center of buoyancy
      * @return forces and torques vector
      */
-    base::Vector6d calcGravityBuoyancy( const base::Orientation& orientation,
+    base::Vector6d calcGravityBuoyancy( const EvaluationContext &context,
             const double& weight, const double& bouyancy,
             const base::Vector3d& cg, const base::Vector3d& cb) const;
 
@@ -12,32 +12,66 @@ DynamicSimulator::DynamicSimulator( double integration_step):
 DynamicSimulator::~DynamicSimulator()
 {}
 
-PoseVelocityState DynamicSimulator::velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input)
+PoseVelocityState DynamicSimulator::velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                                  const EvaluationContext &context) const
 {
     base::Vector6d velocity;
     velocity.head(3) = current_states.linear_velocity;
     velocity.tail(3) = current_states.angular_velocity;
 
-    base::Vector6d vector_acceleration = dynamic_model.calcAcceleration(control_input, velocity, current_states.orientation);
+    base::Vector6d vector_acceleration;
+    const CurrentEnvironment *current = context.current;
+    if(current && current->cache.field)
+    {
+        const base::Vector3d current_velocity = current->cache.field->getVelocity(current_states.position,
+                current->time, current->cache);
+        vector_acceleration = dynamic_model.calcAcceleration(control_input, velocity, current_velocity, context);
+        // Body frame velocity of the current, turning with the vehicle
+        vector_acceleration.head<3>() -= current_states.angular_velocity.cross(context.toBody(current_velocity));
+    }
+    else
+        vector_acceleration = dynamic_model.calcAcceleration(control_input, velocity, context);
 
     PoseVelocityState deriv;
     deriv.linear_velocity = vector_acceleration.head<3>();
     deriv.angular_velocity = vector_acceleration.tail<3>();
-
-    acceleration.linear_acceleration = vector_acceleration.head<3>();
-    acceleration.angular_acceleration = vector_acceleration.tail<3>();
-
     return deriv;
 }
 
-PoseVelocityState DynamicSimulator::poseDeriv(const PoseVelocityState &current_states)
+PoseVelocityState DynamicSimulator::poseDeriv(const PoseVelocityState &/*current_states*/,
+        const EvaluationContext &/*context*/) const
 {
     PoseVelocityState ret;
     return 0*ret;
 }
 
-AccelerationState DynamicSimulator::getAcceleration() const
+base::MatrixXd DynamicSimulator::sensitivityDeriv(const PoseVelocityState &current_states,
+        const base::Vector6d &/*control_input*/, const base::MatrixXd &sensitivity) const
+{
+    EvaluationContext context(current_states.orientation);
+    base::Vector6d velocity;
+    velocity << current_states.linear_velocity, current_states.angular_velocity;
+
+    // d(R^T*e3)/dq, with R^T the rotation of the conjugate quaternion
+    Eigen::Matrix<double, 3, 4> world_z_jacobian = calcRotationJacobian(current_states.orientation.conjugate(),
+            base::Vector3d::UnitZ());
+    world_z_jacobian.leftCols<3>() *= -1;
+
+    base::MatrixXd derivative = base::MatrixXd::Zero(sensitivity.rows(), sensitivity.cols());
+    derivative.bottomRows(6) = dynamic_model.calcAccelerationVelocityJacobian(velocity) * sensitivity.bottomRows(6) +
+            dynamic_model.calcAccelerationOrientationJacobian() * world_z_jacobian * sensitivity.middleRows(3, 4) +
+            dynamic_model.calcAccelerationParameterJacobian(velocity, context);
+    return derivative;
+}
+
+AccelerationState DynamicSimulator::calcAcceleration(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+        const CurrentEnvironment *current) const
 {
+    PoseVelocityState deriv = velocityDeriv(current_states, control_input,
+            EvaluationContext(current_states.orientation, current));
+    AccelerationState acceleration;
+    acceleration.linear_acceleration = deriv.linear_velocity;
+    acceleration.angular_acceleration = deriv.angular_velocity;
     return acceleration;
 }
 
@@ -45,4 +79,9 @@ DynamicModel& DynamicSimulator::getDynamicModel()
 {
     return dynamic_model;
 }
+
+const DynamicModel& DynamicSimulator::getDynamicModel() const
+{
+    return dynamic_model;
+}
 };
@@ -4,6 +4,7 @@
 #include "DataTypes.hpp"
 #include "RK4Integrator.hpp"
 #include "DynamicModel.hpp"
+#include "CurrentField.hpp"
 
 namespace uwv_dynamic_model
 {
@@ -21,30 +22,58 @@ public:
     /** Overrides
      *  Compute Acceleration (velocity derivatives in body frame)
      *
+     *  In a water current (see EvaluationContext::current), the current is
+     *  evaluated at the stage position and the model gives the derivative of
+     *  the velocity relative to the water, see DynamicModel::calcAcceleration.
+     *  The current being constant in world frame, its body frame velocity
+     *  changes with the rotation of the vehicle:
+     *  dv/dt = dv_r/dt - angular_velocity X (R^T * current)
      *  @param current_state
      *  @param forces & torques
+     *  @param context frame conversions of the current orientation
      *  @return Velocity derivatives
      */
-    PoseVelocityState velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input);
+    PoseVelocityState velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                    const EvaluationContext &context) const;
 
     /** Overrides
      * Pose derivatives as zero
      *
      * @param current_states
+     * @param context frame conversions of the current orientation
      * @return zero derivatives
      */
-    PoseVelocityState poseDeriv(const PoseVelocityState &current_states);
+    PoseVelocityState poseDeriv(const PoseVelocityState &current_states, const EvaluationContext &context) const;
 
-    /** Get acceleration
+    /** Overrides
+     *  Compute derivative of the sensitivity matrix
+     *
+     *  Velocity rows only, the pose being constant. The parameters are those
+     *  of DynamicModel::getSensitivityParameterCount. In still water.
+     *  @param current_states
+     *  @param forces & torques
+     *  @param sensitivity 13 x P
+     *  @return 13 x P derivative
+     */
+    base::MatrixXd sensitivityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                    const base::MatrixXd &sensitivity) const;
+
+    /** Compute acceleration at a given state
      *
+     *  Used to get the acceleration matching the state returned by calcStates.
+     * @param current_states
+     * @param control_input
+     * @param current water current of the vehicle, NULL for still water
      * @return Acceleration
      */
-    AccelerationState getAcceleration() const;
+    AccelerationState calcAcceleration(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                       const CurrentEnvironment *current = NULL) const;
 
     /**
      * Access to dynamic_model
      */
     DynamicModel& getDynamicModel();
+    const DynamicModel& getDynamicModel() const;
 
 private:
 
@@ -53,11 +82,6 @@ private:
      */
     DynamicModel dynamic_model;
 
-    /**
-     * Acceleration variables
-     */
-    AccelerationState acceleration;
-
 };
 
 };
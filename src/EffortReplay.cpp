@@ -0,0 +1,68 @@
+#include "EffortReplay.hpp"
+#include "ParallelFor.hpp"
+#include "TrajectoryWriter.hpp"
+#include <memory>
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+EffortReplay::EffortReplay(const std::string &path, ModelSimulator sim, double step_time, int sim_per_cycle)
+    : reader(path), simulator(sim), sampling_time(step_time), simulations_per_cycle(sim_per_cycle)
+{
+    if(reader.size() == 0)
+        throw std::runtime_error("EffortReplay: " + path + " has no samples");
+    initial_state = reader.getSample(0).state;
+}
+
+EffortReplay::~EffortReplay()
+{
+}
+
+void EffortReplay::setInitialState(const PoseVelocityState &state)
+{
+    initial_state = state;
+}
+
+PoseVelocityState EffortReplay::replay(const UWVParameters &parameters, const std::string &output_path) const
+{
+    ModelSimulation model(simulator, sampling_time, simulations_per_cycle, reader.getTime(0));
+    model.setUWVParameters(parameters);
+    model.setPose(initial_state);
+
+    std::unique_ptr<TrajectoryWriter> writer;
+    if(!output_path.empty())
+        writer.reset(new TrajectoryWriter(output_path, reader.getBlockSize()));
+
+    // Efforts are read in place from the mapped columns
+    base::Vector6d effort;
+    PoseVelocityState state = initial_state;
+    for(uint64_t i = 0; i < reader.size(); i++)
+    {
+        for(size_t j = 0; j < 6; j++)
+            effort[j] = reader.getValue(TRAJECTORY_EFFORT + j, i);
+        state = model.sendEffort(effort);
+        if(writer)
+            writer->append(model.getCurrentTime(), state, model.getAcceleration(), effort);
+    }
+    return state;
+}
+
+std::vector<PoseVelocityState> EffortReplay::replay(const std::vector<UWVParameters> &parameters,
+        const std::vector<std::string> &output_paths, unsigned int n_threads) const
+{
+    if(!output_paths.empty() && output_paths.size() != parameters.size())
+        throw std::invalid_argument("EffortReplay: output_paths must be empty or have one path per parameter set");
+
+    std::vector<PoseVelocityState> final_states(parameters.size());
+    parallelFor(parameters.size(), n_threads, [&](size_t i)
+    {
+        final_states[i] = replay(parameters[i], output_paths.empty() ? std::string() : output_paths[i]);
+    });
+    return final_states;
+}
+
+uint64_t EffortReplay::size() const
+{
+    return reader.size();
+}
+};
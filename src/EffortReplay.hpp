@@ -0,0 +1,76 @@
+#ifndef _EFFORT_REPLAY_H_
+#define _EFFORT_REPLAY_H_
+
+#include "ModelSimulation.hpp"
+#include "TrajectoryReader.hpp"
+#include <string>
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/**********************************************************
+ * Effort Replay
+ * Feeds the efforts of a recorded trajectory file through
+ * ModelSimulation, for one or several parameter sets.
+ **********************************************************/
+class EffortReplay
+{
+public:
+    /** Map a recorded trajectory
+     *
+     *  The replay starts at the time and state of the first sample.
+     *  Each recorded effort is applied for one sampling_time.
+     *  @param path of a trajectory file (see TrajectoryFormat.hpp)
+     *  @param sim model simulator used for the replay
+     *  @param sampling_time
+     *  @param sim_per_cycle
+     */
+    EffortReplay(const std::string &path, ModelSimulator sim = DYNAMIC_KINEMATIC,
+                 double sampling_time = 0.01, int sim_per_cycle = 10);
+
+    ~EffortReplay();
+
+    /** Set the initial state used instead of the first recorded state
+     *
+     *  @param initial_state
+     */
+    void setInitialState(const PoseVelocityState &initial_state);
+
+    /** Replay the recorded efforts
+     *
+     *  @param parameters used in the simulation
+     *  @param output_path trajectory file receiving the simulated samples. Empty for no output.
+     *  @return final state
+     */
+    PoseVelocityState replay(const UWVParameters &parameters, const std::string &output_path = "") const;
+
+    /** Replay the recorded efforts for several parameter sets in parallel
+     *
+     *  Each parameter set is simulated sequentially by a single thread, so the
+     *  results do not depend on the number of threads.
+     *  @param parameters one parameter set per replay
+     *  @param output_paths one trajectory file per parameter set, or empty for no output
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return final state of each replay
+     */
+    std::vector<PoseVelocityState> replay(const std::vector<UWVParameters> &parameters,
+                                          const std::vector<std::string> &output_paths = std::vector<std::string>(),
+                                          unsigned int n_threads = 0) const;
+
+    /** Get number of recorded efforts
+     *
+     *  @return number of samples in the recorded trajectory
+     */
+    uint64_t size() const;
+
+private:
+    TrajectoryReader reader;
+
+    ModelSimulator simulator;
+    double sampling_time;
+    int simulations_per_cycle;
+
+    PoseVelocityState initial_state;
+};
+};
+#endif
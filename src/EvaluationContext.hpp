@@ -0,0 +1,97 @@
+#ifndef _EVALUATION_CONTEXT_H_
+#define _EVALUATION_CONTEXT_H_
+
+#include "DataTypes.hpp"
+
+namespace uwv_dynamic_model
+{
+struct CurrentEnvironment;
+
+/**
+ * Frame dependent quantities shared by all the terms of one derivative evaluation.
+ *
+ * Computed once per integration stage from the stage orientation. Terms
+ * needing a frame conversion use it instead of rotating with the quaternion,
+ * so every term sees the same rotation.
+ */
+struct EvaluationContext
+{
+    /**
+     * Rotation matrix from body-frame to world-frame, R
+     */
+    base::Matrix3d rotation;
+
+    /**
+     * Rotation matrix from world-frame to body-frame, R^T
+     */
+    base::Matrix3d rotation_transposed;
+
+    /**
+     * Water current of the vehicle, NULL for still water
+     */
+    const CurrentEnvironment *current;
+
+    explicit EvaluationContext(const base::Orientation &orientation, const CurrentEnvironment *current = NULL)
+        : current(current)
+    {
+        // Stage orientations of the integrator are not unit quaternions
+        rotation = orientation.normalized().toRotationMatrix();
+        rotation_transposed = rotation.transpose();
+    }
+
+    /** Vector in body-frame expressed in world-frame
+     *
+     */
+    inline base::Vector3d toWorld(const base::Vector3d &body) const
+    {
+        return rotation * body;
+    }
+
+    /** Vector in world-frame expressed in body-frame
+     *
+     */
+    inline base::Vector3d toBody(const base::Vector3d &world) const
+    {
+        return rotation_transposed * world;
+    }
+
+    /** World z axis in body-frame, R^T * e3
+     *
+     */
+    inline base::Vector3d worldZInBody() const
+    {
+        return rotation_transposed.col(2);
+    }
+};
+
+/** Derivative of a rotated vector with respect to the quaternion coefficients
+ *
+ *  Derivative of R(q/|q|)*vector with respect to q in (x, y, z, w) order,
+ *  including the normalization. Used to propagate sensitivities.
+ *  @param orientation q, not necessarily normalized
+ *  @param vector
+ *  @return 3 x 4 jacobian
+ */
+inline Eigen::Matrix<double, 3, 4> calcRotationJacobian(const base::Orientation &orientation, const base::Vector3d &vector)
+{
+    /** R(q)*v = ((w^2 - |u|^2)*v + 2*(u.v)*u + 2*w*(u X v)) / |q|^2
+     *  with u the vector part and w the real part of q
+     */
+    const base::Vector3d u = orientation.vec();
+    const double w = orientation.w();
+    const double squared_norm = orientation.coeffs().squaredNorm();
+    const base::Vector3d rotated = (w * w - u.squaredNorm()) * vector + 2 * u.dot(vector) * u + 2 * w * u.cross(vector);
+
+    base::Matrix3d skew_vector;
+    skew_vector << 0, -vector[2], vector[1],
+                   vector[2], 0, -vector[0],
+                  -vector[1], vector[0], 0;
+    Eigen::Matrix<double, 3, 4> jacobian;
+    jacobian.leftCols<3>() = -2 * vector * u.transpose() + 2 * u * vector.transpose() +
+            2 * u.dot(vector) * base::Matrix3d::Identity() - 2 * w * skew_vector;
+    jacobian.col(3) = 2 * w * vector + 2 * u.cross(vector);
+    jacobian -= 2 * rotated * orientation.coeffs().transpose() / squared_norm;
+    return jacobian / squared_norm;
+}
+};
+#endif
@@ -0,0 +1,53 @@
+#include "Events.hpp"
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+bool isEventCrossing(double start, double end, EventDirection direction)
+{
+    bool rising = start < 0 && end >= 0;
+    bool falling = start > 0 && end <= 0;
+    if(direction == EVENT_RISING)
+        return rising;
+    if(direction == EVENT_FALLING)
+        return falling;
+    return rising || falling;
+}
+
+double findEventRoot(const std::function<double(double)> &function, double start, double end, double tolerance)
+{
+    if(end == 0)
+        return 1;
+    if((start < 0) == (end < 0))
+        throw std::invalid_argument("findEventRoot: no sign change on the interval");
+
+    // Regula falsi, halving the value of an end point kept twice in a row
+    double a = 0, b = 1;
+    double fa = start, fb = end;
+    int side = 0;
+    for(int i = 0; i < 100 && b - a > tolerance; i++)
+    {
+        double c = (a * fb - b * fa) / (fb - fa);
+        double fc = function(c);
+        if(fc == 0)
+            return c;
+        if((fc < 0) == (fb < 0))
+        {
+            b = c;
+            fb = fc;
+            if(side == -1)
+                fa /= 2;
+            side = -1;
+        }
+        else
+        {
+            a = c;
+            fa = fc;
+            if(side == 1)
+                fb /= 2;
+            side = 1;
+        }
+    }
+    return b;
+}
+};
@@ -0,0 +1,78 @@
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+#include "DataTypes.hpp"
+#include <functional>
+
+namespace uwv_dynamic_model
+{
+/** Direction of the zero crossing of an event function
+ *
+ * Rising: from negative to positive or zero
+ * Falling: from positive to negative or zero
+ */
+enum EventDirection
+{
+    EVENT_ANY,
+    EVENT_RISING,
+    EVENT_FALLING
+};
+
+/**
+ * Event function of the state, the event occurs when it crosses zero
+ */
+typedef std::function<double(const PoseVelocityState &state)> EventFunction;
+
+/**
+ * Event registered in a simulation
+ */
+struct EventDefinition
+{
+    EventFunction function;
+    EventDirection direction;
+
+    /**
+     * Whether the simulation stops at the event
+     */
+    bool terminal;
+};
+
+/**
+ * Event located during a simulation cycle
+ */
+struct EventOccurrence
+{
+    /**
+     * Index of the event, in order of registration
+     */
+    size_t event;
+
+    /**
+     * Time and state of the zero crossing
+     */
+    double time;
+    PoseVelocityState state;
+
+    bool terminal;
+};
+
+/** Whether an event function crosses zero between two evaluations
+ *
+ *  @param start value at the start of the step
+ *  @param end value at the end of the step
+ *  @param direction of the crossing
+ *  @return crossing
+ */
+bool isEventCrossing(double start, double end, EventDirection direction);
+
+/** Locate the zero crossing of a function on [0, 1] with the Illinois method
+ *
+ *  @param function of the normalized time
+ *  @param start function(0)
+ *  @param end function(1), of opposite sign to start or null
+ *  @param tolerance on the normalized time
+ *  @return normalized time of the crossing, on the side of the end value
+ */
+double findEventRoot(const std::function<double(double)> &function, double start, double end, double tolerance);
+};
+#endif
@@ -1,4 +1,5 @@
 #include "KinematicModel.hpp"
+#include "Profiling.hpp"
 #include <stdexcept>
 
 namespace uwv_dynamic_model
@@ -11,13 +12,19 @@ KinematicModel::~KinematicModel()
 {
 }
 
-base::Vector3d KinematicModel::calcPoseDeriv(const base::Vector3d &linear_velocity, const base::Orientation &orientation)
+base::Vector3d KinematicModel::calcPoseDeriv(const base::Vector3d &linear_velocity, const base::Orientation &orientation) const
 {
+    return calcPoseDeriv(linear_velocity, EvaluationContext(orientation));
+}
+
+base::Vector3d KinematicModel::calcPoseDeriv(const base::Vector3d &linear_velocity, const EvaluationContext &context) const
+{
+    UWV_PROFILE_SCOPE(PROFILE_KINEMATICS);
     checkVelocity(linear_velocity);
-    return orientation.matrix()*linear_velocity;
+    return context.toWorld(linear_velocity);
 }
 
-base::Orientation KinematicModel::calcOrientationDeriv(const base::Vector3d &ang_vel, const base::Orientation &orientation)
+base::Orientation KinematicModel::calcOrientationDeriv(const base::Vector3d &ang_vel, const base::Orientation &orientation) const
 {
     /** Based on Fossen[2011], Andrle[2013] & Wertz[1978]
      *
@@ -43,11 +50,12 @@ base::Orientation KinematicModel::calcOrientationDeriv(const base::Vector3d &ang
      * Andrle, Michael S., and John L. Crassidis. "Geometric integration of quaternions." Journal of Guidance, Control, and Dynamics 36.6 (2013): 1762-1767.
      * (Astrophysics and Space Science Library 73) James R. Wertz (auth.), James R. Wertz (eds.)-Spacecraft Attitude Determination and Control-Springer Netherlands (1978)
      */
+    UWV_PROFILE_SCOPE(PROFILE_KINEMATICS);
     checkVelocity(ang_vel);
     return orientation * base::Orientation(0, ang_vel[0]*0.5, ang_vel[1]*0.5, ang_vel[2]*0.5);
 }
 
-void KinematicModel::checkVelocity(const base::Vector3d &velocity)
+void KinematicModel::checkVelocity(const base::Vector3d &velocity) const
 {
     if(velocity.hasNaN())
         throw std::runtime_error("KinematicModel checkVelocity: velocity is unset");
@@ -2,6 +2,7 @@
 #define _KINEMATIC_MODEL_H_
 
 #include "DataTypes.hpp"
+#include "EvaluationContext.hpp"
 
 namespace uwv_dynamic_model
 {
@@ -18,7 +19,15 @@ public:
      *  @param actual orientation
      *  @return pose derivatives (linear velocity in world-frame)
      */
-    base::Vector3d calcPoseDeriv(const base::Vector3d &linear_velocity, const base::Orientation &orientation);
+    base::Vector3d calcPoseDeriv(const base::Vector3d &linear_velocity, const base::Orientation &orientation) const;
+
+    /** Compute position derivatives/ linear velocity in world-frame
+     *
+     *  @param linear velocity in body frame.
+     *  @param context frame conversions of the actual orientation
+     *  @return pose derivatives (linear velocity in world-frame)
+     */
+    base::Vector3d calcPoseDeriv(const base::Vector3d &linear_velocity, const EvaluationContext &context) const;
 
     /** Compute quaternion derivatives
      *
@@ -26,14 +35,14 @@ public:
      *  @param actual orientation
      *  @return orientation derivatives (quaternion derivatives)
      */
-    base::Orientation calcOrientationDeriv(const base::Vector3d &ang_vel, const base::Orientation &orientation);
+    base::Orientation calcOrientationDeriv(const base::Vector3d &ang_vel, const base::Orientation &orientation) const;
 
     /** Check velocity
      *
      *  Throw if velocity has a NaN
      *  @param velocity
      */
-    void checkVelocity(const base::Vector3d &velocity);
+    void checkVelocity(const base::Vector3d &velocity) const;
 };
 };
 #endif
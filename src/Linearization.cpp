@@ -0,0 +1,158 @@
+#include "Linearization.hpp"
+#include "ModelSimulation.hpp"
+#include "ParallelFor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+base::VectorXd toStateVector(const PoseVelocityState &state)
+{
+    base::VectorXd vector(LINEAR_STATE_SIZE);
+    vector << state.position, state.orientation.coeffs(), state.linear_velocity, state.angular_velocity;
+    return vector;
+}
+
+PoseVelocityState fromStateVector(const base::VectorXd &vector)
+{
+    if(size_t(vector.size()) != LINEAR_STATE_SIZE)
+        throw std::invalid_argument("fromStateVector: the state vector must have 13 elements");
+    PoseVelocityState state;
+    state.position = vector.segment<3>(0);
+    state.orientation.coeffs() = vector.segment<4>(3);
+    state.linear_velocity = vector.segment<3>(7);
+    state.angular_velocity = vector.segment<3>(10);
+    return state;
+}
+
+base::MatrixXd calcMatrixExponential(const base::MatrixXd &matrix)
+{
+    if(matrix.rows() != matrix.cols())
+        throw std::invalid_argument("calcMatrixExponential: the matrix must be square");
+
+    // Scale the matrix to a norm below 1/2, where the approximant is accurate to the double precision
+    const int order = 6;
+    double norm = matrix.cwiseAbs().rowwise().sum().maxCoeff();
+    int squarings = norm > 0.5 ? int(std::ceil(std::log2(norm / 0.5))) : 0;
+    base::MatrixXd scaled = matrix / std::pow(2., squarings);
+
+    /** Pade approximant exp(X) = D(X)^-1 * N(X)
+     *  N(X) = sum(c_k * X^k), D(X) = sum((-1)^k * c_k * X^k)
+     *  c_k = c_(k-1) * (q-k+1) / (k * (2q-k+1))
+     */
+    const base::MatrixXd identity = base::MatrixXd::Identity(matrix.rows(), matrix.cols());
+    base::MatrixXd power = identity;
+    base::MatrixXd numerator = identity;
+    base::MatrixXd denominator = identity;
+    double coefficient = 1;
+    for(int k = 1; k <= order; k++)
+    {
+        coefficient *= double(order - k + 1) / (k * (2 * order - k + 1));
+        power = power * scaled;
+        numerator += coefficient * power;
+        denominator += (k % 2 ? -coefficient : coefficient) * power;
+    }
+    base::MatrixXd exponential = denominator.partialPivLu().solve(numerator);
+
+    for(int i = 0; i < squarings; i++)
+        exponential = exponential * exponential;
+    return exponential;
+}
+
+LinearizationTable::LinearizationTable(const std::vector<double> &speeds, const std::vector<double> &yaw_rates)
+    : speeds(speeds), yaw_rates(yaw_rates)
+{
+    if(speeds.empty() || yaw_rates.empty())
+        throw std::invalid_argument("LinearizationTable: the grid must have at least one speed and one yaw rate");
+    for(size_t i = 1; i < speeds.size(); i++)
+        if(!(speeds[i] > speeds[i - 1]))
+            throw std::invalid_argument("LinearizationTable: speeds must be strictly increasing");
+    for(size_t i = 1; i < yaw_rates.size(); i++)
+        if(!(yaw_rates[i] > yaw_rates[i - 1]))
+            throw std::invalid_argument("LinearizationTable: yaw rates must be strictly increasing");
+}
+
+LinearizationTable::~LinearizationTable()
+{
+}
+
+void LinearizationTable::build(const ModelSimulation &simulation, DiscretizationMethod method, unsigned int n_threads)
+{
+    DynamicModel model;
+    model.setUWVParameters(simulation.getUWVParameters());
+
+    std::vector<LinearModel> new_nodes(speeds.size() * yaw_rates.size());
+    parallelFor(new_nodes.size(), n_threads, [&](size_t i)
+    {
+        PoseVelocityState state;
+        state.linear_velocity[0] = speeds[i / yaw_rates.size()];
+        state.angular_velocity[2] = yaw_rates[i % yaw_rates.size()];
+        base::Vector6d velocity;
+        velocity << state.linear_velocity, state.angular_velocity;
+        base::Vector6d control_input = model.calcSteadyStateEfforts(velocity, state.orientation);
+        new_nodes[i] = simulation.linearize(state, control_input, method);
+    });
+    nodes.swap(new_nodes);
+}
+
+void LinearizationTable::findCell(const std::vector<double> &grid, double value, size_t &index, double &weight) const
+{
+    if(grid.size() == 1 || value <= grid.front())
+    {
+        index = 0;
+        weight = 0;
+        return;
+    }
+    if(value >= grid.back())
+    {
+        index = grid.size() - 2;
+        weight = 1;
+        return;
+    }
+    index = std::upper_bound(grid.begin(), grid.end(), value) - grid.begin() - 1;
+    weight = (value - grid[index]) / (grid[index + 1] - grid[index]);
+}
+
+LinearModel LinearizationTable::lookup(double speed, double yaw_rate) const
+{
+    if(!isBuilt())
+        throw std::runtime_error("LinearizationTable: lookup before build");
+
+    size_t i, j;
+    double wi, wj;
+    findCell(speeds, speed, i, wi);
+    findCell(yaw_rates, yaw_rate, j, wj);
+    size_t i1 = std::min(i + 1, speeds.size() - 1);
+    size_t j1 = std::min(j + 1, yaw_rates.size() - 1);
+
+    const LinearModel *corners[4] = {&getNode(i, j), &getNode(i1, j), &getNode(i, j1), &getNode(i1, j1)};
+    const double weights[4] = {(1 - wi) * (1 - wj), wi * (1 - wj), (1 - wi) * wj, wi * wj};
+
+    LinearModel model;
+    model.A.setZero();
+    base::VectorXd state = base::VectorXd::Zero(LINEAR_STATE_SIZE);
+    for(size_t k = 0; k < 4; k++)
+    {
+        model.A += weights[k] * corners[k]->A;
+        model.B += weights[k] * corners[k]->B;
+        model.c += weights[k] * corners[k]->c;
+        model.control_input += weights[k] * corners[k]->control_input;
+        state += weights[k] * toStateVector(corners[k]->state);
+    }
+    model.state = fromStateVector(state);
+    return model;
+}
+
+const LinearModel& LinearizationTable::getNode(size_t speed_index, size_t yaw_rate_index) const
+{
+    if(speed_index >= speeds.size() || yaw_rate_index >= yaw_rates.size() || !isBuilt())
+        throw std::out_of_range("LinearizationTable: node out of the grid");
+    return nodes[speed_index * yaw_rates.size() + yaw_rate_index];
+}
+
+bool LinearizationTable::isBuilt() const
+{
+    return !nodes.empty();
+}
+};
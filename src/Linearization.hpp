@@ -0,0 +1,160 @@
+#ifndef _LINEARIZATION_H_
+#define _LINEARIZATION_H_
+
+#include "DataTypes.hpp"
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+class ModelSimulation;
+
+/** Discretization of the linearized model
+ *
+ * Matrix_Exponential:
+ * Zero-order hold of the continuous linearization over the sampling time.
+ *
+ * Integrator:
+ * Linearization of one cycle of the simulation (simulations_per_cycle steps
+ * of the integration scheme), consistent with sendEffort. It includes the
+ * normalization of the orientation done after each step.
+ */
+enum DiscretizationMethod
+{
+    MATRIX_EXPONENTIAL,
+    INTEGRATOR
+};
+
+/** Size of the linearized state vector
+ *
+ * x = [position; orientation (x, y, z, w); linear velocity; angular velocity]
+ */
+static const size_t LINEAR_STATE_SIZE = 13;
+
+/**
+ * Discrete time affine model around an operating point:
+ *  x[k+1] - x_op = A*(x[k] - x_op) + B*(u[k] - u_op) + c
+ * The operating point does not need to be an equilibrium, c being the
+ * motion over one sampling period from the operating point.
+ */
+struct LinearModel
+{
+    /**
+     * Operating point
+     */
+    PoseVelocityState state;
+    base::Vector6d control_input;
+
+    /**
+     * 13 x 13 state matrix
+     */
+    base::MatrixXd A;
+
+    /**
+     * 13 x 6 input matrix
+     */
+    base::MatrixXd B;
+
+    /**
+     * 13 affine term, null at an equilibrium
+     */
+    base::VectorXd c;
+
+    LinearModel():
+        control_input(base::Vector6d::Zero()),
+        A(base::MatrixXd::Identity(LINEAR_STATE_SIZE, LINEAR_STATE_SIZE)),
+        B(base::MatrixXd::Zero(LINEAR_STATE_SIZE, 6)),
+        c(base::VectorXd::Zero(LINEAR_STATE_SIZE))
+    {
+    }
+};
+
+/** Convert a state to the linearized state vector
+ *
+ *  @param state
+ *  @return 13 state vector
+ */
+base::VectorXd toStateVector(const PoseVelocityState &state);
+
+/** Convert a linearized state vector to a state
+ *
+ *  @param vector 13 state vector
+ *  @return state
+ */
+PoseVelocityState fromStateVector(const base::VectorXd &vector);
+
+/** Compute the exponential of a square matrix
+ *
+ *  Scaling and squaring with a [6/6] Pade approximant.
+ *  @param matrix
+ *  @return exp(matrix)
+ */
+base::MatrixXd calcMatrixExponential(const base::MatrixXd &matrix);
+
+/**********************************************************
+ * Linearization Table
+ * Linear models on a grid of surge speed and yaw rate, for gain scheduling.
+ *
+ * The operating point of each node is the steady motion with the node surge
+ * speed and yaw rate (body-frame velocity [speed, 0, 0], angular velocity
+ * [0, 0, yaw_rate], null roll and pitch) and the efforts keeping it
+ * (DynamicModel::calcSteadyStateEfforts). Lookups interpolate bilinearly
+ * between nodes and clamp outside of the grid.
+ **********************************************************/
+class LinearizationTable
+{
+public:
+    /** Constructor
+     *
+     *  @param speeds surge speed of the nodes, strictly increasing
+     *  @param yaw_rates yaw rate of the nodes, strictly increasing
+     */
+    LinearizationTable(const std::vector<double> &speeds, const std::vector<double> &yaw_rates);
+
+    ~LinearizationTable();
+
+    /** Linearize the simulation at every node
+     *
+     *  @param simulation model, simulator, sampling time and integration settings
+     *  @param method discretization
+     *  @param n_threads number of threads. 0 for the number of cores.
+     */
+    void build(const ModelSimulation &simulation, DiscretizationMethod method = MATRIX_EXPONENTIAL,
+               unsigned int n_threads = 0);
+
+    /** Interpolate the linear model
+     *
+     *  @param speed surge speed
+     *  @param yaw_rate
+     *  @return linear model, with interpolated operating point
+     */
+    LinearModel lookup(double speed, double yaw_rate) const;
+
+    /** Get the model of one node
+     *
+     *  @param speed_index
+     *  @param yaw_rate_index
+     *  @return linear model
+     */
+    const LinearModel& getNode(size_t speed_index, size_t yaw_rate_index) const;
+
+    /** Whether build was called
+     *
+     */
+    bool isBuilt() const;
+
+private:
+    /**
+     * Index of the lower node and interpolation weight of the upper one
+     */
+    void findCell(const std::vector<double> &grid, double value, size_t &index, double &weight) const;
+
+    std::vector<double> speeds;
+    std::vector<double> yaw_rates;
+
+    /**
+     * Nodes, speed major
+     */
+    std::vector<LinearModel> nodes;
+};
+};
+#endif
@@ -1,11 +1,46 @@
 #include "ModelSimulation.hpp"
+#include <base-logging/Logging.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
 
 
 namespace uwv_dynamic_model
 {
+namespace
+{
+/**
+ * Zero-order hold of the velocities of a SIMPLE model without quadratic damping, false for other models
+ */
+bool calcExactDiscretization(const DynamicModel &model, double sampling_time, base::Matrix6d &transition,
+        base::Matrix6d &input)
+{
+    if(model.getModelType() != SIMPLE)
+        return false;
+    UWVParameters parameters = model.getUWVParameters();
+    if(!parameters.damping_matrices[1].isZero(0))
+        return false;
+
+    // exp([A I; 0 0]*T) = [exp(A*T) integral(exp(A*s)); 0 I], A = -M^(-1) * linDamping
+    Eigen::JacobiSVD<base::MatrixXd> svd(parameters.inertia_matrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    base::MatrixXd augmented = base::MatrixXd::Zero(12, 12);
+    augmented.topLeftCorner(6, 6) = -svd.solve(parameters.damping_matrices[0]) * sampling_time;
+    augmented.topRightCorner(6, 6) = base::Matrix6d::Identity() * sampling_time;
+    base::MatrixXd exponential = calcMatrixExponential(augmented);
+    transition = exponential.topLeftCorner(6, 6);
+    input = exponential.topRightCorner(6, 6);
+    return true;
+}
+}
+
 ModelSimulation::ModelSimulation(ModelSimulator sim, double sampling_time, int sim_per_cycle,
                                  double initial_time)
+    : model_simulator(sim), kinematic_step_ratio(1), exact_discretization(false), exact_enabled(true), exact_allowed(false),
+      exact_sampling_time(0), input_delay(0),
+      input_rate_limit(base::Vector6d::Constant(std::numeric_limits<double>::infinity())),
+      delay_head(0), delay_count(0), applied_effort(base::Vector6d::Zero()),
+      dense_output(false), dense_start_time(0), dense_end_time(0), published_model(NULL), retired_models(NULL), profile_dump_period(0), profile_cycles(0)
 {
     checkConstruction(sampling_time, sim_per_cycle, initial_time);
     if(sim == DYNAMIC)
@@ -22,6 +57,8 @@ ModelSimulation::ModelSimulation(ModelSimulator sim, double sampling_time, int s
 
 ModelSimulation::~ModelSimulation()
 {
+    delete published_model.exchange(NULL);
+    deleteRetiredModels();
     delete simulator;
 }
 
@@ -37,26 +74,463 @@ PoseVelocityState ModelSimulation::sendEffort(const base::Vector6d &control_inpu
 {
     // Checks control input and states
     checkControlInput(control_input);
+    startCycle(actual_pose);
+
+    // Constant efforts without stepping features: exact or multi-rate cycle
+    if(!dense_output && events.empty() && !hasInputStage() && (exact_discretization || kinematic_step_ratio > 1))
+    {
+        PoseVelocityState state;
+        {
+            UWV_PROFILE_STATS(&profile_stats);
+            if(exact_discretization)
+                state = calcExactCycle(actual_pose, control_input);
+            else
+                state = calcMultiRateCycle(actual_pose, control_input, current_time, current_cache);
+        }
+        return finishCycle(state, control_input, current_time + sampling_time);
+    }
+
+    return integrateCycle(actual_pose, [&](int /*step*/, const PoseVelocityState &/*state*/,
+            base::Vector6d &start_input, base::Vector6d &middle_input, base::Vector6d &end_input)
+    {
+        start_input = middle_input = end_input = control_input;
+    });
+}
+
+void ModelSimulation::startCycle(const PoseVelocityState &actual_pose)
+{
     checkState(actual_pose);
 
-    PoseVelocityState state = actual_pose;
+    applyPublishedUWVParameters();
+
+    event_occurrences.clear();
+    if(dense_output)
+    {
+        dense_steps.clear();
+        dense_start_time = current_time;
+    }
+}
+
+PoseVelocityState ModelSimulation::finishCycle(const PoseVelocityState &state, const base::Vector6d &control_input,
+        double end_time)
+{
+    {
+        UWV_PROFILE_STATS(&profile_stats);
+        CurrentEnvironment current(current_cache, end_time);
+        acceleration = simulator->calcAcceleration(state, control_input, &current);
+    }
+
+#ifdef UWV_DYNAMIC_MODEL_PROFILING
+    if(profile_dump_period && ++profile_cycles >= profile_dump_period)
+    {
+        profile_cycles = 0;
+        LOG_INFO_S << "uwv_dynamic_model profiling at time " << end_time << std::endl << profile_stats;
+    }
+#endif
+
+    current_time = end_time;
+    if(dense_output)
+        dense_end_time = end_time;
+    return state;
+}
+
+bool ModelSimulation::hasInputStage() const
+{
+    return input_delay > 0 || (input_rate_limit.array() < std::numeric_limits<double>::infinity()).any();
+}
+
+void ModelSimulation::checkNoInputStage() const
+{
+    if(hasInputStage())
+        throw std::runtime_error("ModelSimulation: single cycles have no input history, "
+                                 "unset the input delay and rate limit");
+}
+
+base::Vector6d ModelSimulation::calcInputStage(double time, double step, const base::Vector6d &control_input)
+{
+    // The oldest effort is overwritten once the buffer is full
+    delay_head = (delay_head + 1) % delay_times.size();
+    delay_times[delay_head] = time;
+    delay_efforts[delay_head] = control_input;
+    delay_count = std::min(delay_count + 1, delay_times.size());
+
+    // Last effort sent at or before the delayed middle of the step, newest first
+    base::Vector6d delayed_effort = base::Vector6d::Zero();
+    const double delayed_time = time + step / 2 - input_delay;
+    for(size_t i = 0; i < delay_count; i++)
+    {
+        size_t index = (delay_head + delay_times.size() - i) % delay_times.size();
+        if(delay_times[index] <= delayed_time)
+        {
+            delayed_effort = delay_efforts[index];
+            break;
+        }
+    }
+
+    const base::Vector6d max_change = input_rate_limit * step;
+    applied_effort += (delayed_effort - applied_effort).cwiseMax(-max_change).cwiseMin(max_change);
+    return applied_effort;
+}
+
+void ModelSimulation::resetInputStage()
+{
+    // Steps starting in [t - delay, t], plus the one sent before them, plus
+    // one cycle so that the steps of a rejected cycle overwrite none of them
+    size_t capacity = std::ceil(input_delay / (sampling_time / simulations_per_cycle)) + 2 + simulations_per_cycle;
+    delay_times.assign(capacity, 0);
+    delay_efforts.assign(capacity, base::Vector6d::Zero());
+    delay_head = 0;
+    delay_count = 0;
+    applied_effort = base::Vector6d::Zero();
+}
+
+void ModelSimulation::setInputDelay(double delay)
+{
+    if(!(delay >= 0) || std::isinf(delay))
+        throw std::invalid_argument("ModelSimulation: input delay must be positive or equal to zero");
+    input_delay = delay;
+    resetInputStage();
+}
+
+double ModelSimulation::getInputDelay() const
+{
+    return input_delay;
+}
+
+void ModelSimulation::setInputRateLimit(const base::Vector6d &rate)
+{
+    if(rate.hasNaN() || (rate.array() <= 0).any())
+        throw std::invalid_argument("ModelSimulation: input rate limit must be positive");
+    input_rate_limit = rate;
+}
+
+base::Vector6d ModelSimulation::getInputRateLimit() const
+{
+    return input_rate_limit;
+}
+
+base::Vector6d ModelSimulation::getAppliedEffort() const
+{
+    return applied_effort;
+}
+
+bool ModelSimulation::detectEvents(const DenseOutputStep &step_output, double start_time, PoseVelocityState &end,
+        double &end_time)
+{
+    std::vector<EventOccurrence> step_occurrences;
+    for(size_t e = 0; e < events.size(); e++)
+    {
+        const EventDefinition &event = events[e];
+        double start_value = event.function(step_output.start);
+        double end_value = event.function(step_output.end);
+        if(!isEventCrossing(start_value, end_value, event.direction))
+            continue;
 
-    // Performs iterations to calculate the new system's states
+        double theta = findEventRoot([&](double theta) { return event.function(step_output.interpolate(theta)); },
+                start_value, end_value, 1e-12);
+
+        EventOccurrence occurrence;
+        occurrence.event = e;
+        occurrence.time = start_time + theta * step_output.step;
+        occurrence.state = step_output.interpolate(theta);
+        occurrence.terminal = event.terminal;
+        step_occurrences.push_back(occurrence);
+    }
+
+    std::sort(step_occurrences.begin(), step_occurrences.end(),
+            [](const EventOccurrence &a, const EventOccurrence &b) { return a.time < b.time; });
+    for(size_t i = 0; i < step_occurrences.size(); i++)
+    {
+        event_occurrences.push_back(step_occurrences[i]);
+        if(step_occurrences[i].terminal)
+        {
+            end = step_occurrences[i].state;
+            end_time = step_occurrences[i].time;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ModelSimulation::addEvent(const EventFunction &function, EventDirection direction, bool terminal)
+{
+    EventDefinition event;
+    event.function = function;
+    event.direction = direction;
+    event.terminal = terminal;
+    events.push_back(event);
+    return events.size() - 1;
+}
+
+void ModelSimulation::clearEvents()
+{
+    events.clear();
+    event_occurrences.clear();
+}
+
+const std::vector<EventOccurrence>& ModelSimulation::getEventOccurrences() const
+{
+    return event_occurrences;
+}
+
+void ModelSimulation::setDenseOutput(bool enable)
+{
+    dense_output = enable;
+    dense_steps.clear();
+}
+
+PoseVelocityState ModelSimulation::getStateAt(double time) const
+{
+    if(dense_steps.empty())
+        throw std::runtime_error("ModelSimulation: no dense output, see setDenseOutput");
+    if(time < dense_start_time || time > dense_end_time)
+        throw std::invalid_argument("ModelSimulation: time outside of the last cycle");
+
+    const double step = dense_steps.front().step;
+    size_t index = std::min<size_t>((time - dense_start_time) / step, dense_steps.size() - 1);
+    double theta = std::min(1., (time - dense_start_time - index * step) / step);
+    return dense_steps[index].interpolate(theta);
+}
+
+PoseVelocityState ModelSimulation::simulateCycle(const PoseVelocityState &actual_pose, const base::Vector6d &control_input) const
+{
+    return simulateCycle(actual_pose, control_input, current_time);
+}
+
+PoseVelocityState ModelSimulation::simulateCycle(const PoseVelocityState &actual_pose, const base::Vector6d &control_input,
+        double start_time) const
+{
+    checkNoInputStage();
+    checkState(actual_pose);
+    checkControlInput(control_input);
+    if(exact_discretization)
+        return calcExactCycle(actual_pose, control_input);
+    // Cache of this call, the simulation one belonging to the stepping thread
+    CurrentFieldCache cache(current_cache.field);
+    if(kinematic_step_ratio > 1)
+        return calcMultiRateCycle(actual_pose, control_input, start_time, cache);
+
+    PoseVelocityState state = actual_pose;
+    const double step = sampling_time / simulations_per_cycle;
     for (int i=0; i < simulations_per_cycle; i++)
-        state = calcStates(state, control_input);
+    {
+        CurrentEnvironment current(cache, start_time + i * step);
+        state = simulator->calcStep(state, control_input, control_input, control_input, NULL, &current);
+    }
+    return state;
+}
+
+void ModelSimulation::setCurrentField(const std::shared_ptr<const CurrentField> &field)
+{
+    current_cache = CurrentFieldCache(field);
+    updateExactDiscretization();
+}
+
+std::shared_ptr<const CurrentField> ModelSimulation::getCurrentField() const
+{
+    return current_cache.field;
+}
+
+PoseVelocityState ModelSimulation::sendEffortProfile(const EffortProfile &profile)
+{
+    PoseVelocityState actual_state = sendEffortProfile(profile, getPose());
+    setPose(actual_state);
+    return actual_state;
+}
+
+PoseVelocityState ModelSimulation::sendEffortRamp(const base::Vector6d &start_effort, const base::Vector6d &end_effort)
+{
+    const double period = sampling_time;
+    return sendEffortProfile([&](double time)
+    {
+        return base::Vector6d(start_effort + (end_effort - start_effort) * (time / period));
+    });
+}
+
+PoseVelocityState ModelSimulation::sendEffortProfile(const EffortProfile &profile, const PoseVelocityState &actual_pose)
+{
+    startCycle(actual_pose);
+
+    const double step = sampling_time / simulations_per_cycle;
+    base::Vector6d last_effort = profile(0);
+    return integrateCycle(actual_pose, [&](int i, const PoseVelocityState &/*state*/, base::Vector6d &start_input,
+            base::Vector6d &middle_input, base::Vector6d &end_input)
+    {
+        // The end of a step is the start of the next one
+        start_input = last_effort;
+        middle_input = profile((i + 0.5) * step);
+        end_input = last_effort = profile((i + 1) * step);
+    });
+}
+
+void ModelSimulation::setThrusterConfiguration(const std::shared_ptr<const ThrusterConfiguration> &configuration)
+{
+    thruster_configuration = configuration;
+    thrusts = base::VectorXd::Zero(configuration ? configuration->getThrusterCount() : 0);
+}
+
+std::shared_ptr<const ThrusterConfiguration> ModelSimulation::getThrusterConfiguration() const
+{
+    return thruster_configuration;
+}
+
+const base::VectorXd& ModelSimulation::getThrusts() const
+{
+    return thrusts;
+}
+
+PoseVelocityState ModelSimulation::sendThrusterCommands(const base::VectorXd &commands)
+{
+    PoseVelocityState actual_state = sendThrusterCommands(commands, getPose());
+    setPose(actual_state);
+    return actual_state;
+}
 
-    current_time += sampling_time;
+PoseVelocityState ModelSimulation::sendThrusterCommands(const base::VectorXd &commands, const PoseVelocityState &actual_pose)
+{
+    if(!thruster_configuration)
+        throw std::runtime_error("ModelSimulation: no thruster configuration, see setThrusterConfiguration");
+    if(commands.hasNaN())
+        throw std::runtime_error("thruster commands have a NaN.");
+
+    const ThrusterConfiguration &configuration = *thruster_configuration;
+    const base::VectorXd target_thrusts = configuration.calcThrusts(commands);
+    if(configuration.isInstantaneous())
+    {
+        PoseVelocityState state = sendEffort(base::Vector6d(configuration.calcEfforts(target_thrusts)), actual_pose);
+        thrusts = target_thrusts;
+        return state;
+    }
+
+    // efforts(t) = T*target + sum(T_i * (thrust_i - target_i) * exp(-t/tau_i))
+    const std::vector<ThrusterDefinition> &thrusters = configuration.getThrusters();
+    const base::Vector6d steady_efforts = configuration.calcEfforts(target_thrusts);
+    const base::MatrixXd transient_efforts = configuration.getConfigurationMatrix() *
+            (thrusts - target_thrusts).asDiagonal();
+    const double start_time = current_time;
+    PoseVelocityState state = sendEffortProfile([&](double time)
+    {
+        base::Vector6d efforts = steady_efforts;
+        for(size_t i = 0; i < thrusters.size(); i++)
+        {
+            if(thrusters[i].time_constant > 0)
+                efforts += transient_efforts.col(i) * std::exp(-time / thrusters[i].time_constant);
+        }
+        return efforts;
+    }, actual_pose);
+    // A terminal event may end the cycle early
+    thrusts = configuration.calcThrustResponse(thrusts, target_thrusts, current_time - start_time);
+    return state;
+}
+
+PoseVelocityState ModelSimulation::calcMultiRateCycle(const PoseVelocityState &actual_pose,
+        const base::Vector6d &control_input, double start_time, CurrentFieldCache &cache) const
+{
+    PoseVelocityState state = actual_pose;
+    const double step = sampling_time / simulations_per_cycle;
+    for (int i=0; i < simulations_per_cycle; i += kinematic_step_ratio)
+    {
+        CurrentEnvironment current(cache, start_time + i * step);
+        state = simulator->calcMultiRateStates(state, control_input,
+                std::min(kinematic_step_ratio, simulations_per_cycle - i), &current);
+    }
+    return state;
+}
+
+PoseVelocityState ModelSimulation::calcExactCycle(const PoseVelocityState &actual_pose, const base::Vector6d &control_input) const
+{
+    PoseVelocityState state = actual_pose;
+    state.orientation.normalize();
+
+    // Acceleration at null velocity: M^(-1)*(efforts - restoring), constant over the cycle
+    base::Vector6d forcing = simulator->getDynamicModel().calcAcceleration(control_input, base::Vector6d::Zero(),
+            state.orientation);
+    base::Vector6d velocity;
+    velocity << state.linear_velocity, state.angular_velocity;
+    velocity = exact_transition * velocity + exact_input * forcing;
+
+    state.linear_velocity = velocity.head<3>();
+    state.angular_velocity = velocity.tail<3>();
     return state;
 }
 
+void ModelSimulation::updateExactDiscretization()
+{
+    exact_allowed = exact_enabled && model_simulator == DYNAMIC && getIntegrationScheme() == RUNGE_KUTTA_4 &&
+            !current_cache.field;
+    exact_sampling_time = sampling_time;
+    exact_discretization = exact_allowed &&
+            calcExactDiscretization(simulator->getDynamicModel(), sampling_time, exact_transition, exact_input);
+}
+
 PoseVelocityState ModelSimulation::calcStates(const PoseVelocityState &actual_pose, const base::Vector6d &control_input)
 {
-    return simulator->calcStates(actual_pose,control_input);
+    CurrentEnvironment current(current_cache, current_time);
+    return simulator->calcStep(actual_pose, control_input, control_input, control_input, NULL, &current);
+}
+
+LinearModel ModelSimulation::linearize(const PoseVelocityState &state, const base::Vector6d &control_input,
+        DiscretizationMethod method) const
+{
+    return linearize(state, control_input, method, current_time);
+}
+
+LinearModel ModelSimulation::linearize(const PoseVelocityState &state, const base::Vector6d &control_input,
+        DiscretizationMethod method, double time) const
+{
+    checkNoInputStage();
+    // Continuous state derivative or state after one cycle
+    CurrentFieldCache cache(current_cache.field);
+    CurrentEnvironment current(cache, time);
+    auto function = [&](const base::VectorXd &x, const base::Vector6d &u)
+    {
+        PoseVelocityState next = fromStateVector(x);
+        if(method == MATRIX_EXPONENTIAL)
+            return toStateVector(simulator->deriv(next, u, &current));
+        return toStateVector(simulateCycle(next, u, time));
+    };
+
+    const base::VectorXd x = toStateVector(state);
+    const base::VectorXd operating = function(x, control_input);
+    base::MatrixXd jacobian(LINEAR_STATE_SIZE, LINEAR_STATE_SIZE + 6);
+    for(size_t j = 0; j < LINEAR_STATE_SIZE + 6; j++)
+    {
+        base::VectorXd dx = base::VectorXd::Zero(LINEAR_STATE_SIZE);
+        base::Vector6d du = base::Vector6d::Zero();
+        double h;
+        if(j < LINEAR_STATE_SIZE)
+            h = dx[j] = 1e-6 * std::max(1., std::abs(x[j]));
+        else
+            h = du[j - LINEAR_STATE_SIZE] = 1e-6 * std::max(1., std::abs(control_input[j - LINEAR_STATE_SIZE]));
+        jacobian.col(j) = (function(x + dx, control_input + du) - function(x - dx, control_input - du)) / (2 * h);
+    }
+
+    LinearModel model;
+    model.state = state;
+    model.control_input = control_input;
+    if(method == MATRIX_EXPONENTIAL)
+    {
+        // exp([A B f; 0 0 0]*T) = [Ad Bd c; 0 I 0], f the derivative at the operating point
+        base::MatrixXd augmented = base::MatrixXd::Zero(LINEAR_STATE_SIZE + 7, LINEAR_STATE_SIZE + 7);
+        augmented.topLeftCorner(LINEAR_STATE_SIZE, LINEAR_STATE_SIZE + 6) = jacobian * sampling_time;
+        augmented.block(0, LINEAR_STATE_SIZE + 6, LINEAR_STATE_SIZE, 1) = operating * sampling_time;
+        base::MatrixXd exponential = calcMatrixExponential(augmented);
+        model.A = exponential.topLeftCorner(LINEAR_STATE_SIZE, LINEAR_STATE_SIZE);
+        model.B = exponential.block(0, LINEAR_STATE_SIZE, LINEAR_STATE_SIZE, 6);
+        model.c = exponential.block(0, LINEAR_STATE_SIZE + 6, LINEAR_STATE_SIZE, 1);
+    }
+    else
+    {
+        model.A = jacobian.leftCols(LINEAR_STATE_SIZE);
+        model.B = jacobian.rightCols(6);
+        model.c = operating - x;
+    }
+    return model;
 }
 
 AccelerationState ModelSimulation::getAcceleration() const
 {
-    return simulator->getAcceleration();
+    return acceleration;
 }
 
 UWVParameters ModelSimulation::getUWVParameters() const
@@ -66,7 +540,76 @@ UWVParameters ModelSimulation::getUWVParameters() const
 
 void ModelSimulation::setUWVParameters(const UWVParameters &parameters)
 {
-    return simulator->getDynamicModel().setUWVParameters(parameters);
+    UWV_PROFILE_STATS(&profile_stats);
+    simulator->getDynamicModel().setUWVParameters(parameters);
+    profile_stats.model_type = parameters.model_type;
+    updateExactDiscretization();
+}
+
+void ModelSimulation::setExactDiscretization(bool enable)
+{
+    exact_enabled = enable;
+    updateExactDiscretization();
+}
+
+void ModelSimulation::publishUWVParameters(const UWVParameters &parameters)
+{
+    deleteRetiredModels();
+    PublishedModel *published = new PublishedModel();
+    try
+    {
+        published->model.setUWVParameters(parameters);
+    }
+    catch(...)
+    {
+        delete published;
+        throw;
+    }
+    published->exact_allowed = exact_allowed;
+    published->exact_sampling_time = exact_sampling_time;
+    published->exact_discretization = published->exact_allowed && calcExactDiscretization(published->model,
+            published->exact_sampling_time, published->exact_transition, published->exact_input);
+    // A set that was not applied yet is dropped
+    delete published_model.exchange(published, std::memory_order_acq_rel);
+}
+
+bool ModelSimulation::hasPendingUWVParameters() const
+{
+    return published_model.load(std::memory_order_acquire) != NULL;
+}
+
+void ModelSimulation::applyPublishedUWVParameters()
+{
+    PublishedModel *published = published_model.exchange(NULL, std::memory_order_acq_rel);
+    if(!published)
+        return;
+    simulator->getDynamicModel().swap(published->model);
+    profile_stats.model_type = simulator->getDynamicModel().getModelType();
+    // Discretization of the publishing thread, unless the settings changed since
+    if(published->exact_allowed == exact_allowed && published->exact_sampling_time == sampling_time)
+    {
+        exact_discretization = published->exact_discretization;
+        exact_transition = published->exact_transition;
+        exact_input = published->exact_input;
+    }
+    else
+        updateExactDiscretization();
+    // The replaced model is freed by the publishing thread, see deleteRetiredModels
+    published->next_retired = retired_models.load(std::memory_order_relaxed);
+    while(!retired_models.compare_exchange_weak(published->next_retired, published,
+            std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+void ModelSimulation::deleteRetiredModels()
+{
+    PublishedModel *retired = retired_models.exchange(NULL, std::memory_order_acquire);
+    while(retired)
+    {
+        PublishedModel *next = retired->next_retired;
+        delete retired;
+        retired = next;
+    }
 }
 
 void ModelSimulation::resetStates()
@@ -104,7 +647,7 @@ void ModelSimulation::setPose(const PoseVelocityState& current_pose)
     pose = current_pose;
 }
 
-double ModelSimulation::getSamplingTime()
+double ModelSimulation::getSamplingTime() const
 {
     return sampling_time;
 }
@@ -115,6 +658,8 @@ void ModelSimulation::setSamplingTime(double step_time)
     checkSamplingTime(step_time);
     sampling_time = step_time;
     simulator->setIntegrationStep(step_time/getSimPerCycle());
+    updateExactDiscretization();
+    resetInputStage();
 }
 
 int ModelSimulation::getSimPerCycle() const
@@ -122,6 +667,51 @@ int ModelSimulation::getSimPerCycle() const
     return simulations_per_cycle;
 }
 
+void ModelSimulation::setIntegrationScheme(IntegrationScheme scheme)
+{
+    simulator->setIntegrationScheme(scheme);
+    updateExactDiscretization();
+}
+
+IntegrationScheme ModelSimulation::getIntegrationScheme() const
+{
+    return simulator->getIntegrationScheme();
+}
+
+void ModelSimulation::setKinematicStepRatio(int ratio)
+{
+    if (ratio <= 0)
+        throw std::runtime_error("kinematic_step_ratio must be positive");
+    kinematic_step_ratio = ratio;
+}
+
+int ModelSimulation::getKinematicStepRatio() const
+{
+    return kinematic_step_ratio;
+}
+
+ModelSimulator ModelSimulation::getModelSimulator() const
+{
+    return model_simulator;
+}
+
+ProfileStats ModelSimulation::getProfileStats() const
+{
+    return profile_stats;
+}
+
+void ModelSimulation::resetProfileStats()
+{
+    profile_stats.reset();
+    profile_cycles = 0;
+}
+
+void ModelSimulation::setProfileDumpPeriod(unsigned int period)
+{
+    profile_dump_period = period;
+    profile_cycles = 0;
+}
+
 void ModelSimulation::checkConstruction(double &sampling_time,
         int &sim_per_cycle, double &initial_time)
 {
@@ -143,13 +733,13 @@ void ModelSimulation::checkSimulationTime(double simulation_time)
         throw std::runtime_error("simulationTime must be positive or equal to zero");
 }
 
-void ModelSimulation::checkControlInput(const base::Vector6d &control_input)
+void ModelSimulation::checkControlInput(const base::Vector6d &control_input) const
 {
     if(control_input.hasNaN())
         throw std::runtime_error("control input has a NaN.");
 }
 
-void ModelSimulation::checkState(const PoseVelocityState &state)
+void ModelSimulation::checkState(const PoseVelocityState &state) const
 {
     if(state.hasNaN())
         throw std::runtime_error("state has a NaN.");
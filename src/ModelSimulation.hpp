@@ -3,9 +3,20 @@
 
 #include "DynamicSimulator.hpp"
 #include "DynamicKinematicSimulator.hpp"
+#include "Profiling.hpp"
+#include "Linearization.hpp"
+#include "Events.hpp"
+#include "ThrusterConfiguration.hpp"
+#include <atomic>
+#include <functional>
 
 namespace uwv_dynamic_model
 {
+/**
+ * Efforts in body frame as a function of the time since the start of the cycle, in [0, sampling_time]
+ */
+typedef std::function<base::Vector6d(double)> EffortProfile;
+
 class ModelSimulation
 {
 public:
@@ -29,6 +40,216 @@ public:
      */
     PoseVelocityState sendEffort(const base::Vector6d &control_input, const PoseVelocityState &actual_pose);
 
+    /** Set the delay of the efforts
+     *
+     *  Applies to all the send functions. The efforts sent for each
+     *  integration step (at the middle of the step for sendEffortProfile and
+     *  thrusters) are kept in a ring buffer covering the delay, allocated here
+     *  and when the sampling time changes, and the delayed efforts are looked
+     *  up at the middle of every integration step and held over it. The delay
+     *  does not need to be a multiple of the sampling time. Before the first
+     *  delayed effort, the applied efforts are null. While an input delay or a
+     *  rate limit is set, cycles are integrated step by step (no exact
+     *  discretization or multi-rate steps), and simulateCycle and linearize,
+     *  which have no input history, throw. Resets the input stage.
+     * @param delay in seconds, 0 to disable
+     */
+    void setInputDelay(double delay);
+
+    /** Get the delay of the efforts
+     *
+     *  @return delay in seconds
+     */
+    double getInputDelay() const;
+
+    /** Set the rate limit of the efforts
+     *
+     *  Applied after the delay, at every integration step of all the send
+     *  functions: the applied efforts move toward the delayed ones by at most
+     *  rate * step. See setInputDelay for the restrictions.
+     * @param rate maximum rate of change of each effort, infinity to disable
+     */
+    void setInputRateLimit(const base::Vector6d &rate);
+
+    /** Get the rate limit of the efforts
+     *
+     *  @return maximum rate of change of each effort
+     */
+    base::Vector6d getInputRateLimit() const;
+
+    /** Whether an input delay or rate limit is set
+     *
+     *  @return true if the efforts go through the input stage
+     */
+    bool hasInputStage() const;
+
+    /** Get the efforts applied at the end of the last cycle
+     *
+     *  Output of the input delay and rate limit stage.
+     *  @return efforts in body frame
+     */
+    base::Vector6d getAppliedEffort() const;
+
+    /** Register an event
+     *
+     *  The event functions are evaluated at the end of every integration
+     *  step of sendEffort, sendEffortProfile, sendControlledEffort and
+     *  sendThrusterCommands. When one crosses zero in the given direction, the
+     *  crossing is located on the dense output of the step (see
+     *  DenseOutputStep::interpolate) with the Illinois method, so its
+     *  precision does not depend on the step. A terminal event ends the
+     *  cycle: the send function returns the state at the event and the
+     *  current time is the event time. While events are registered, cycles are integrated
+     *  step by step (no exact discretization or multi-rate steps).
+     * @param function event function of the state
+     * @param direction of the zero crossing
+     * @param terminal whether the simulation stops at the event
+     * @return index of the event
+     */
+    size_t addEvent(const EventFunction &function, EventDirection direction = EVENT_ANY, bool terminal = true);
+
+    /** Remove all the events
+     *
+     */
+    void clearEvents();
+
+    /** Get the events located by the last cycle
+     *
+     *  @return occurrences in order of time, the last one being terminal if the cycle was stopped
+     */
+    const std::vector<EventOccurrence>& getEventOccurrences() const;
+
+    /** Enable the dense output of the cycles of all the send functions
+     *
+     *  The stages of every integration step of the cycle are kept, so the
+     *  state can be interpolated at any time of the last cycle with
+     *  getStateAt. While enabled, cycles are integrated step by step (no
+     *  exact discretization or multi-rate steps).
+     * @param enable
+     */
+    void setDenseOutput(bool enable);
+
+    /** Get the state at any time of the last cycle
+     *
+     *  Interpolated from the stages of the integration step containing the
+     *  time, see DenseOutputStep::interpolate. No model evaluation.
+     * @param time between the start and the end of the last cycle
+     * @return interpolated state
+     */
+    PoseVelocityState getStateAt(double time) const;
+
+    /** Send Effort commands varying over the cycle
+     *
+     *  The profile is evaluated at the time of each integration stage, so
+     *  inputs changing within the cycle are integrated instead of held. The
+     *  cycle is always integrated, even when the exact discretization of
+     *  linear SIMPLE models applies to constant efforts.
+     * @param profile efforts over the cycle
+     * @param actual_pose
+     * @return computed pose state
+     */
+    PoseVelocityState sendEffortProfile(const EffortProfile &profile, const PoseVelocityState &actual_pose);
+
+    /** Send Effort commands varying over the cycle, from the current pose
+     *
+     * @param profile efforts over the cycle
+     * @return computed pose state
+     */
+    PoseVelocityState sendEffortProfile(const EffortProfile &profile);
+
+    /** Send Effort commands with first-order hold, from the current pose
+     *
+     *  The efforts are linearly interpolated over the cycle.
+     * @param start_effort efforts at the start of the cycle
+     * @param end_effort efforts at the end of the cycle
+     * @return computed pose state
+     */
+    PoseVelocityState sendEffortRamp(const base::Vector6d &start_effort, const base::Vector6d &end_effort);
+
+    /** Run a controller at the integration rate over one cycle
+     *
+     *  Before each of the simulations_per_cycle steps, the controller is
+     *  called with the current state and time and returns the efforts held
+     *  over that step. The controller type is a template parameter, so the
+     *  call is resolved at compile time and can be inlined in the stepping
+     *  loop. The cycle is always integrated.
+     * @param controller callable as base::Vector6d(const PoseVelocityState &state, double time)
+     * @param actual_pose
+     * @return computed pose state
+     */
+    template<class Controller>
+    PoseVelocityState sendControlledEffort(Controller &&controller, const PoseVelocityState &actual_pose);
+
+    /** Run a controller at the integration rate over one cycle, from the current pose
+     *
+     * @param controller callable as base::Vector6d(const PoseVelocityState &state, double time)
+     * @return computed pose state
+     */
+    template<class Controller>
+    PoseVelocityState sendControlledEffort(Controller &&controller);
+
+    /** Set the water current
+     *
+     *  Damping and Coriolis act on the velocity relative to the water, the
+     *  current being evaluated at the position of every integration stage,
+     *  see DynamicSimulator::velocityDeriv. Time-varying fields are evaluated
+     *  at the start of each integration step, or of each multi-rate step. The
+     *  simulation keeps its own cell cache of gridded fields, so a field can
+     *  be shared by several simulations and threads. The exact discretization
+     *  of linear SIMPLE models is not used in a current. Linearizations are at
+     *  the current time.
+     *  @param field NULL for still water
+     */
+    void setCurrentField(const std::shared_ptr<const CurrentField> &field);
+
+    /** Get the water current
+     *
+     *  @return field, NULL for still water
+     */
+    std::shared_ptr<const CurrentField> getCurrentField() const;
+
+    /** Set the thrusters of the vehicle
+     *
+     *  Used by sendThrusterCommands. The thrusts are reset to zero. A
+     *  configuration can be shared by several simulations.
+     *  @param configuration NULL to remove the thrusters
+     */
+    void setThrusterConfiguration(const std::shared_ptr<const ThrusterConfiguration> &configuration);
+
+    /** Get the thrusters of the vehicle
+     *
+     *  @return configuration, NULL without thrusters
+     */
+    std::shared_ptr<const ThrusterConfiguration> getThrusterConfiguration() const;
+
+    /** Send thruster commands to the model given the actual states
+     *
+     *  The commands are held over the cycle. The thrusts follow the
+     *  first-order response of the thrusters to the steady-state thrusts of
+     *  the commands, and the resulting efforts are evaluated at the time of
+     *  each integration stage, see sendEffortProfile. With instantaneous
+     *  thrusters, the cycle is a sendEffort of the steady-state efforts. Both
+     *  run the stepping loop of sendEffort, so events and dense output apply
+     *  whatever the time constants.
+     * @param commands one per thruster
+     * @param actual_pose
+     * @return computed pose state
+     */
+    PoseVelocityState sendThrusterCommands(const base::VectorXd &commands, const PoseVelocityState &actual_pose);
+
+    /** Send thruster commands to the model, from the current pose
+     *
+     * @param commands one per thruster
+     * @return computed pose state
+     */
+    PoseVelocityState sendThrusterCommands(const base::VectorXd &commands);
+
+    /** Get the thrusts at the end of the last sendThrusterCommands
+     *
+     *  @return one thrust per thruster
+     */
+    const base::VectorXd& getThrusts() const;
+
     /** Do one step simulation
      *
      *  To be override by specific simulator
@@ -38,9 +259,31 @@ public:
      */
     virtual PoseVelocityState calcStates(const PoseVelocityState &actual_pose, const base::Vector6d &control_input);
 
+    /** Simulate one sampling period from a given state
+     *
+     *  Same cycle as sendEffort, without changing the simulation (pose,
+     *  time, acceleration) and without events. Can be called from several
+     *  threads. Throws while an input delay or rate limit is set, see
+     *  setInputDelay.
+     * @param actual_pose state
+     * @param control_input
+     * @param start_time time at the start of the cycle, for time-varying currents
+     * @return state after sampling_time
+     */
+    PoseVelocityState simulateCycle(const PoseVelocityState &actual_pose, const base::Vector6d &control_input,
+                                    double start_time) const;
+
+    /** Simulate one sampling period from a given state, starting at the current time
+     *
+     * @param actual_pose state
+     * @param control_input
+     * @return state after sampling_time
+     */
+    PoseVelocityState simulateCycle(const PoseVelocityState &actual_pose, const base::Vector6d &control_input) const;
+
     /** Get Acceleration
      *
-     *  To be override by specific simulator
+     *  Acceleration at the state computed by the last sendEffort.
      *  @return Acceleration
      */
     virtual AccelerationState getAcceleration() const;
@@ -55,10 +298,47 @@ public:
     /** Get UWV Parameters
      *
      *  To be override by specific simulator
+     *
+     *  With the DYNAMIC simulator and the RUNGE_KUTTA_4 scheme, SIMPLE models
+     *  without quadratic damping have linear time-invariant velocity dynamics
+     *  (the orientation, hence the restoring efforts, being constant). Their
+     *  zero-order hold transition over the sampling time is then precomputed
+     *  and each cycle is exact, instead of integrated.
      *  @param UWV Parameters
      */
     virtual void setUWVParameters(const UWVParameters &parameters);
 
+    /** Allow the exact discretization of linear SIMPLE models
+     *
+     *  Enabled by default, see setUWVParameters. When disabled, the cycles
+     *  are always integrated with the integration scheme.
+     *  @param enable
+     */
+    void setExactDiscretization(bool enable);
+
+    /** Publish UWV Parameters from any thread
+     *
+     *  The parameters are checked and the model terms (inverse of the inertia
+     *  matrix, ...) are computed in the calling thread. The new model replaces
+     *  the current one at the start of the next sendEffort, so a cycle always
+     *  runs with a single parameter set. The stepping thread never waits for
+     *  the publishing one. A set published before the previous one was applied
+     *  replaces it. The exact discretization of linear SIMPLE models (see
+     *  setUWVParameters) is also computed in the calling thread, for the
+     *  sampling time at the time of the call. Only if the sampling time,
+     *  the scheme or the current field change before the set is applied is
+     *  it recomputed by the stepping thread. The model replaced by a set is
+     *  freed by the next call, not by the stepping thread.
+     *  @param parameters
+     */
+    void publishUWVParameters(const UWVParameters &parameters);
+
+    /** Whether published parameters wait for the next sendEffort
+     *
+     *  @return true if parameters are pending
+     */
+    bool hasPendingUWVParameters() const;
+
     /** Reset pose states
      *
      */
@@ -98,7 +378,7 @@ public:
      *
      *  @return sampling time
      */
-    double getSamplingTime();
+    double getSamplingTime() const;
 
     /** Set Sampling Time
      *
@@ -112,6 +392,86 @@ public:
      */
     int getSimPerCycle() const;
 
+    /** Set Integration Scheme
+     *
+     *  @param scheme, RUNGE_KUTTA_4 by default
+     */
+    void setIntegrationScheme(IntegrationScheme scheme);
+
+    /** Get Integration Scheme
+     *
+     *  @return scheme
+     */
+    IntegrationScheme getIntegrationScheme() const;
+
+    /** Set the ratio between the dynamic and kinematic rates
+     *
+     *  With a ratio n > 1, sendEffort cycles integrate the pose once every n
+     *  integration steps of the velocities, see
+     *  RK4Integrator::calcMultiRateStates. The efforts profile and controller
+     *  cycles are not affected.
+     *  @param ratio number of velocity steps per pose step, 1 by default
+     */
+    void setKinematicStepRatio(int ratio);
+
+    /** Get the ratio between the dynamic and kinematic rates
+     *
+     *  @return number of velocity steps per pose step
+     */
+    int getKinematicStepRatio() const;
+
+    /** Get Model Simulator
+     *
+     *  @return simulator, DYNAMIC or DYNAMIC_KINEMATIC
+     */
+    ModelSimulator getModelSimulator() const;
+
+    /** Linearize one cycle around an operating point
+     *
+     *  Jacobians by central differences, of the state derivative for
+     *  MATRIX_EXPONENTIAL and of the cycle map for INTEGRATOR, see
+     *  Linearization.hpp. Any state and effort can be used as operating point,
+     *  the affine term of the model holding the motion from a point that is
+     *  not an equilibrium. Time-varying currents are taken at the current time.
+     *  Throws while an input delay or rate limit is set, see setInputDelay.
+     *  @param state operating state
+     *  @param control_input operating efforts
+     *  @param method discretization
+     *  @return discrete time model at sampling_time
+     */
+    LinearModel linearize(const PoseVelocityState &state, const base::Vector6d &control_input,
+                          DiscretizationMethod method = MATRIX_EXPONENTIAL) const;
+
+    /** Linearize one cycle around an operating point at a given time
+     *
+     *  @param state operating state
+     *  @param control_input operating efforts
+     *  @param method discretization
+     *  @param time of the operating point, for time-varying currents
+     *  @return discrete time model at sampling_time
+     */
+    LinearModel linearize(const PoseVelocityState &state, const base::Vector6d &control_input,
+                          DiscretizationMethod method, double time) const;
+
+    /** Get the calls and cycles spent in each term of the model
+     *
+     *  Only filled when the library is built with UWV_DYNAMIC_MODEL_PROFILING.
+     *  @return profiling counters of this simulation
+     */
+    ProfileStats getProfileStats() const;
+
+    /** Reset profiling counters
+     *
+     */
+    void resetProfileStats();
+
+    /** Set the period of the profiling dump
+     *
+     *  The counters are written to the log every period cycles. 0 disables the dump.
+     *  @param period in number of sendEffort cycles
+     */
+    void setProfileDumpPeriod(unsigned int period);
+
 private:
 
     /** Check if the variables provided in the class construction are valid
@@ -139,14 +499,111 @@ private:
      *  Throw exception if control input has a NaN
      *  @param control_input
      */
-    void checkControlInput(const base::Vector6d &control_input);
+    void checkControlInput(const base::Vector6d &control_input) const;
 
     /** Check state
      *
      * Throw exception if state has a NaN
      * @param state
      */
-    void checkState(const PoseVelocityState &state);
+    void checkState(const PoseVelocityState &state) const;
+
+    /** Replace the model with the last published one, if any
+     *
+     */
+    void applyPublishedUWVParameters();
+
+    /** Free the models replaced by applyPublishedUWVParameters
+     *
+     *  Called by publishUWVParameters and the destructor, so the stepping
+     *  thread never frees memory.
+     */
+    void deleteRetiredModels();
+
+    /** Recompute the exact discretization after a change of model, sampling time or scheme
+     *
+     */
+    void updateExactDiscretization();
+
+    /** Prepare a cycle
+     *
+     *  Checks the state, applies the published parameters and clears the
+     *  events and dense output of the last cycle.
+     *  @param actual_pose
+     */
+    void startCycle(const PoseVelocityState &actual_pose);
+
+    /** Integrate one cycle step by step
+     *
+     *  Stepping loop of all the send functions, so the input stage, the
+     *  events and the dense output apply to all of them.
+     *  @param actual_pose
+     *  @param efforts callable as void(int step, const PoseVelocityState &state,
+     *  base::Vector6d &start_input, base::Vector6d &middle_input, base::Vector6d &end_input),
+     *  setting the efforts at the start, middle and end of each integration step
+     *  @return state at the end of the cycle or at a terminal event
+     */
+    template<class Efforts>
+    PoseVelocityState integrateCycle(const PoseVelocityState &actual_pose, Efforts &&efforts);
+
+    /** Complete a cycle
+     *
+     *  Computes the acceleration, dumps the profiling counters and advances the time.
+     *  @param state at the end of the cycle
+     *  @param control_input efforts applied at the end of the cycle
+     *  @param end_time
+     *  @return state
+     */
+    PoseVelocityState finishCycle(const PoseVelocityState &state, const base::Vector6d &control_input, double end_time);
+
+    /** Compute one cycle with the exact discretization
+     *
+     *  @param state actual state
+     *  @param control_input
+     *  @return state at the end of the cycle
+     */
+    PoseVelocityState calcExactCycle(const PoseVelocityState &state, const base::Vector6d &control_input) const;
+
+    /** Reallocate the delay line after a change of delay or sampling time
+     *
+     */
+    void resetInputStage();
+
+    /** Throw if an input delay or rate limit is set
+     *
+     */
+    void checkNoInputStage() const;
+
+    /** Apply the input delay and rate limit over one integration step
+     *
+     *  @param time at the start of the step
+     *  @param step integration step
+     *  @param control_input efforts sent for the step
+     *  @return efforts applied over the step
+     */
+    base::Vector6d calcInputStage(double time, double step, const base::Vector6d &control_input);
+
+    /** Locate the events crossed during a step
+     *
+     *  @param step_output dense output of the step
+     *  @param start_time time at the start of the step
+     *  @param end state at the end of the step, replaced by the state at a terminal event
+     *  @param end_time set to the time of a terminal event
+     *  @return whether a terminal event occurred
+     */
+    bool detectEvents(const DenseOutputStep &step_output, double start_time, PoseVelocityState &end,
+                      double &end_time);
+
+    /** Compute one cycle with multi-rate steps
+     *
+     *  @param state actual state
+     *  @param control_input
+     *  @param start_time time at the start of the cycle
+     *  @param cache cell cache of the current field
+     *  @return state at the end of the cycle
+     */
+    PoseVelocityState calcMultiRateCycle(const PoseVelocityState &state, const base::Vector6d &control_input,
+                                         double start_time, CurrentFieldCache &cache) const;
 
     /**
      * SYSTEM STATES
@@ -157,6 +614,11 @@ private:
      */
     PoseVelocityState pose;
 
+    /**
+     * Acceleration at the last computed state
+     */
+    AccelerationState acceleration;
+
     /**
      * SIMULATION PARAMETERS
      */
@@ -173,6 +635,173 @@ private:
      * Simulator
      */
     DynamicSimulator *simulator;
+    ModelSimulator model_simulator;
+
+    /**
+     * Velocity steps per pose step
+     */
+    int kinematic_step_ratio;
+
+    /**
+     * Zero-order hold of linear SIMPLE models, dv/dt = A*v + M^(-1)*(efforts - restoring)
+     */
+    bool exact_discretization;
+    // exp(A*sampling_time), A = -M^(-1) * linDamping
+    base::Matrix6d exact_transition;
+    // Integral of exp(A*s) for s in [0, sampling_time]
+    base::Matrix6d exact_input;
+
+    /**
+     * Whether the exact discretization is enabled by the user
+     */
+    bool exact_enabled;
+
+    /**
+     * Whether the user, simulator, scheme and environment allow the exact
+     * discretization, and its sampling time. Read by publishUWVParameters.
+     */
+    std::atomic<bool> exact_allowed;
+    std::atomic<double> exact_sampling_time;
+
+    /**
+     * Input stage: efforts sent for each integration step with their times in
+     * a ring buffer covering the delay, and rate limited efforts applied to the model
+     */
+    double input_delay;
+    base::Vector6d input_rate_limit;
+    std::vector<double> delay_times;
+    std::vector<base::Vector6d> delay_efforts;
+    size_t delay_head;
+    size_t delay_count;
+    base::Vector6d applied_effort;
+
+    /**
+     * Registered events and occurrences of the last cycle
+     */
+    std::vector<EventDefinition> events;
+    std::vector<EventOccurrence> event_occurrences;
+
+    /**
+     * Steps of the last cycle for dense output, and its time span
+     */
+    bool dense_output;
+    std::vector<DenseOutputStep> dense_steps;
+    double dense_start_time;
+    double dense_end_time;
+
+    /**
+     * Water current of the vehicle, with the cell cache of the stepping thread
+     */
+    CurrentFieldCache current_cache;
+
+    /**
+     * Thrusters and their actual thrusts
+     */
+    std::shared_ptr<const ThrusterConfiguration> thruster_configuration;
+    base::VectorXd thrusts;
+
+    /**
+     * Model published by publishUWVParameters with its exact discretization,
+     * computed by the publishing thread for the settings it read
+     */
+    struct PublishedModel
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        DynamicModel model;
+        bool exact_allowed;
+        double exact_sampling_time;
+        bool exact_discretization;
+        base::Matrix6d exact_transition;
+        base::Matrix6d exact_input;
+        PublishedModel *next_retired;
+    };
+
+    /**
+     * Last published model, owned by whoever takes it out
+     */
+    std::atomic<PublishedModel*> published_model;
+
+    /**
+     * Models replaced by the stepping thread, linked by next_retired and
+     * waiting to be freed by deleteRetiredModels
+     */
+    std::atomic<PublishedModel*> retired_models;
+
+    /**
+     * Profiling counters, see Profiling.hpp
+     */
+    ProfileStats profile_stats;
+    unsigned int profile_dump_period;
+    unsigned int profile_cycles;
 };
+
+template<class Efforts>
+PoseVelocityState ModelSimulation::integrateCycle(const PoseVelocityState &actual_pose, Efforts &&efforts)
+{
+    PoseVelocityState state = actual_pose;
+    double end_time = current_time + sampling_time;
+    // Steps are kept for the events and the dense output
+    const bool keep_steps = dense_output || !events.empty();
+    const bool input_stage = hasInputStage();
+    base::Vector6d start_input, middle_input, end_input;
+    // Input stage at the start of the cycle, restored if the cycle is rejected
+    const size_t first_delay_head = delay_head;
+    const size_t first_delay_count = delay_count;
+    const base::Vector6d first_applied_effort = applied_effort;
+    try
+    {
+        UWV_PROFILE_STATS(&profile_stats);
+        const double step = sampling_time / simulations_per_cycle;
+        DenseOutputStep step_output;
+        for (int i=0; i < simulations_per_cycle; i++)
+        {
+            const double step_time = current_time + i * step;
+            const PoseVelocityState &current_state = state;
+            efforts(i, current_state, start_input, middle_input, end_input);
+            // Invalid efforts never enter the input stage
+            checkControlInput(start_input);
+            checkControlInput(middle_input);
+            checkControlInput(end_input);
+            if(input_stage)
+                start_input = middle_input = end_input = calcInputStage(step_time, step, middle_input);
+            CurrentEnvironment current(current_cache, step_time);
+            state = simulator->calcStep(state, start_input, middle_input, end_input,
+                    keep_steps ? &step_output : NULL, &current);
+            if(dense_output)
+                dense_steps.push_back(step_output);
+            if(!events.empty() && detectEvents(step_output, step_time, state, end_time))
+                break;
+        }
+    }
+    catch(...)
+    {
+        delay_head = first_delay_head;
+        delay_count = first_delay_count;
+        applied_effort = first_applied_effort;
+        throw;
+    }
+    return finishCycle(state, end_input, end_time);
+}
+
+template<class Controller>
+PoseVelocityState ModelSimulation::sendControlledEffort(Controller &&controller, const PoseVelocityState &actual_pose)
+{
+    startCycle(actual_pose);
+
+    const double step = sampling_time / simulations_per_cycle;
+    return integrateCycle(actual_pose, [&](int i, const PoseVelocityState &state, base::Vector6d &start_input,
+            base::Vector6d &middle_input, base::Vector6d &end_input)
+    {
+        start_input = middle_input = end_input = controller(state, current_time + i * step);
+    });
+}
+
+template<class Controller>
+PoseVelocityState ModelSimulation::sendControlledEffort(Controller &&controller)
+{
+    PoseVelocityState actual_state = sendControlledEffort(controller, getPose());
+    setPose(actual_state);
+    return actual_state;
+}
 };
 #endif
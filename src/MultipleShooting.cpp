@@ -0,0 +1,70 @@
+#include "MultipleShooting.hpp"
+#include "ParallelFor.hpp"
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+MultipleShooting::MultipleShooting(const ModelSimulation &simulation)
+    : simulation(simulation)
+{
+}
+
+MultipleShooting::~MultipleShooting()
+{
+}
+
+std::vector<PoseVelocityState> MultipleShooting::simulateSegments(const std::vector<PoseVelocityState> &states,
+        const std::vector<base::Vector6d> &controls, unsigned int n_threads) const
+{
+    if(states.size() != controls.size())
+        throw std::invalid_argument("MultipleShooting: one control per segment is required");
+
+    std::vector<PoseVelocityState> end_states(states.size());
+    const double start_time = simulation.getCurrentTime();
+    const double sampling_time = simulation.getSamplingTime();
+    parallelFor(states.size(), n_threads, [&](size_t i)
+    {
+        end_states[i] = simulation.simulateCycle(states[i], controls[i], start_time + i * sampling_time);
+    });
+    return end_states;
+}
+
+ShootingEvaluation MultipleShooting::evaluate(const std::vector<PoseVelocityState> &nodes,
+        const std::vector<base::Vector6d> &controls, bool with_jacobians, unsigned int n_threads) const
+{
+    const size_t n = controls.size();
+    if(n == 0 || nodes.size() != n + 1)
+        throw std::invalid_argument("MultipleShooting: N + 1 nodes and N > 0 controls are required");
+
+    ShootingEvaluation evaluation;
+    evaluation.end_states.resize(n);
+    evaluation.defects.resize(LINEAR_STATE_SIZE, n);
+    if(with_jacobians)
+        evaluation.jacobians.resize(n);
+    const double start_time = simulation.getCurrentTime();
+    const double sampling_time = simulation.getSamplingTime();
+    parallelFor(n, n_threads, [&](size_t i)
+    {
+        PoseVelocityState &end_state = evaluation.end_states[i];
+        const double time = start_time + i * sampling_time;
+        end_state = simulation.simulateCycle(nodes[i], controls[i], time);
+        // Same orientation on the side of the next node, so the defect does not depend on the quaternion sign
+        const bool flipped = end_state.orientation.coeffs().dot(nodes[i + 1].orientation.coeffs()) < 0;
+        if(flipped)
+            end_state.orientation.coeffs() *= -1;
+        evaluation.defects.col(i) = toStateVector(nodes[i + 1]) - toStateVector(end_state);
+        if(with_jacobians)
+        {
+            LinearModel &jacobian = evaluation.jacobians[i];
+            jacobian = simulation.linearize(nodes[i], controls[i], INTEGRATOR, time);
+            if(flipped)
+            {
+                jacobian.A.middleRows(3, 4) *= -1;
+                jacobian.B.middleRows(3, 4) *= -1;
+                jacobian.c = toStateVector(end_state) - toStateVector(nodes[i]);
+            }
+        }
+    });
+    return evaluation;
+}
+};
@@ -0,0 +1,86 @@
+#ifndef _MULTIPLE_SHOOTING_H_
+#define _MULTIPLE_SHOOTING_H_
+
+#include "ModelSimulation.hpp"
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/**
+ * Evaluation of the segments of a multiple-shooting problem
+ */
+struct ShootingEvaluation
+{
+    /**
+     * State at the end of each segment, with the sign of the quaternion of
+     * the next node (q and -q being the same orientation)
+     */
+    std::vector<PoseVelocityState> end_states;
+
+    /**
+     * 13 x N continuity defects (see toStateVector), one column per segment:
+     * toStateVector(nodes[i+1]) - toStateVector(end_states[i])
+     */
+    base::MatrixXd defects;
+
+    /**
+     * Linearization of each segment, A = d(end state)/d(start state) and
+     * B = d(end state)/d(control), around its start state and control, for
+     * the sign of the end quaternion of end_states.
+     * The defect i has the Jacobians -A, -B and identity with respect to
+     * nodes[i+1]. Empty unless requested.
+     */
+    std::vector<LinearModel> jacobians;
+};
+
+/**********************************************************
+ * Multiple Shooting
+ * Continuity defects of a trajectory split into N segments of one sampling
+ * period, for direct multiple-shooting trajectory optimization.
+ *
+ * Segment i starts at nodes[i] with the constant efforts controls[i] and is
+ * simulated with ModelSimulation::simulateCycle, starting at the current time
+ * of the simulation plus i sampling periods. The segments are
+ * independent, so they are split between threads. The simulation is not
+ * modified and can be shared with other evaluations.
+ **********************************************************/
+class MultipleShooting
+{
+public:
+    /** Constructor
+     *
+     *  @param simulation model, simulator, sampling time and integration settings.
+     *                    Must outlive the evaluator.
+     */
+    MultipleShooting(const ModelSimulation &simulation);
+
+    ~MultipleShooting();
+
+    /** Simulate every segment
+     *
+     *  @param states start state of each segment
+     *  @param controls efforts of each segment, same size as states
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return state at the end of each segment
+     */
+    std::vector<PoseVelocityState> simulateSegments(const std::vector<PoseVelocityState> &states,
+                                                    const std::vector<base::Vector6d> &controls,
+                                                    unsigned int n_threads = 0) const;
+
+    /** Compute the continuity defects of a trajectory
+     *
+     *  @param nodes N+1 states, N >= 1
+     *  @param controls N efforts
+     *  @param with_jacobians whether to linearize each segment (ModelSimulation::linearize
+     *                        with the INTEGRATOR discretization)
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @return end states, defects and optionally Jacobians
+     */
+    ShootingEvaluation evaluate(const std::vector<PoseVelocityState> &nodes, const std::vector<base::Vector6d> &controls,
+                                bool with_jacobians = false, unsigned int n_threads = 0) const;
+
+private:
+    const ModelSimulation &simulation;
+};
+};
+#endif
@@ -0,0 +1,73 @@
+#ifndef _PARALLEL_FOR_H_
+#define _PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/** Number of worker threads to use
+ *
+ *  @param n_threads requested number of threads. 0 for the number of cores.
+ *  @param n_tasks number of independent tasks
+ *  @return number of threads, at least one and at most n_tasks
+ */
+inline unsigned int getThreadCount(unsigned int n_threads, size_t n_tasks)
+{
+    if(n_threads == 0)
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if(n_tasks < n_threads)
+        n_threads = n_tasks;
+    return std::max(1u, n_threads);
+}
+
+/** Call function(i) for i in [0, n) using a pool of threads
+ *
+ *  Tasks are handed out dynamically, so their order of execution is not defined.
+ *  The first exception thrown by a task is rethrown once all threads are joined.
+ *  @param n number of tasks
+ *  @param n_threads number of threads. 0 for the number of cores.
+ *  @param function callable with a size_t argument
+ */
+template<class Function>
+void parallelFor(size_t n, unsigned int n_threads, const Function &function)
+{
+    n_threads = getThreadCount(n_threads, n);
+    if(n_threads == 1)
+    {
+        for(size_t i = 0; i < n; i++)
+            function(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::exception_ptr> errors(n_threads);
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads);
+    for(unsigned int t = 0; t < n_threads; t++)
+    {
+        threads.push_back(std::thread([&, t]()
+        {
+            try
+            {
+                for(size_t i = next++; i < n; i = next++)
+                    function(i);
+            }
+            catch(...)
+            {
+                errors[t] = std::current_exception();
+                next = n;
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    for(size_t t = 0; t < errors.size(); t++)
+        if(errors[t])
+            std::rethrow_exception(errors[t]);
+}
+};
+#endif
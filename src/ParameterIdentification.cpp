@@ -0,0 +1,341 @@
+#include "ParameterIdentification.hpp"
+#include "ParallelFor.hpp"
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+namespace
+{
+/**
+ * Samples folded per QR update
+ */
+const size_t BLOCK_SAMPLES = 64;
+
+/**
+ * Samples stored in vectors
+ */
+struct VectorSource
+{
+    const std::vector<base::Vector6d> &accelerations;
+    const std::vector<base::Vector6d> &velocities;
+    const std::vector<base::Orientation> &orientations;
+    const std::vector<base::Vector6d> &efforts;
+
+    VectorSource(const std::vector<base::Vector6d> &accelerations, const std::vector<base::Vector6d> &velocities,
+                 const std::vector<base::Orientation> &orientations, const std::vector<base::Vector6d> &efforts)
+        : accelerations(accelerations), velocities(velocities), orientations(orientations), efforts(efforts)
+    {
+    }
+
+    inline void get(size_t i, base::Vector6d &acceleration, base::Vector6d &velocity,
+                    base::Orientation &orientation, base::Vector6d &effort) const
+    {
+        acceleration = accelerations[i];
+        velocity = velocities[i];
+        orientation = orientations[i];
+        effort = efforts[i];
+    }
+};
+
+/**
+ * Samples read in place from a mapped trajectory file
+ */
+struct TrajectorySource
+{
+    const TrajectoryReader &reader;
+
+    TrajectorySource(const TrajectoryReader &reader)
+        : reader(reader)
+    {
+    }
+
+    inline void get(size_t i, base::Vector6d &acceleration, base::Vector6d &velocity,
+                    base::Orientation &orientation, base::Vector6d &effort) const
+    {
+        for(size_t j = 0; j < 3; j++)
+        {
+            acceleration[j] = reader.getValue(TRAJECTORY_LINEAR_ACCELERATION + j, i);
+            acceleration[j + 3] = reader.getValue(TRAJECTORY_ANGULAR_ACCELERATION + j, i);
+            velocity[j] = reader.getValue(TRAJECTORY_LINEAR_VELOCITY + j, i);
+            velocity[j + 3] = reader.getValue(TRAJECTORY_ANGULAR_VELOCITY + j, i);
+        }
+        for(size_t j = 0; j < 4; j++)
+            orientation.coeffs()[j] = reader.getValue(TRAJECTORY_ORIENTATION + j, i);
+        for(size_t j = 0; j < 6; j++)
+            effort[j] = reader.getValue(TRAJECTORY_EFFORT + j, i);
+    }
+};
+}
+
+ParameterIdentification::ParameterIdentification(ModelType model_type, MatrixStructure structure)
+    : model_type(model_type), structure(structure)
+{
+    reset();
+}
+
+ParameterIdentification::~ParameterIdentification()
+{
+}
+
+size_t ParameterIdentification::getMatrixParameterCount() const
+{
+    return structure == FULL_MATRICES ? 36 : 6;
+}
+
+size_t ParameterIdentification::getDampingMatrixCount() const
+{
+    return model_type == COMPLEX ? 6 : 2;
+}
+
+size_t ParameterIdentification::getParameterCount() const
+{
+    // Inertia, damping matrices and the 4 restoring terms
+    return getMatrixParameterCount() * (1 + getDampingMatrixCount()) + 4;
+}
+
+base::MatrixXd ParameterIdentification::calcRegressor(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+        const base::Orientation &orientation) const
+{
+    base::MatrixXd rows = base::MatrixXd::Zero(6, getParameterCount());
+    fillRegressor(acceleration, velocity, EvaluationContext(orientation), rows);
+    return rows;
+}
+
+void ParameterIdentification::fillRegressor(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+        const EvaluationContext &context, base::MatrixXd &rows) const
+{
+    const size_t n = getMatrixParameterCount();
+    const base::Vector3d linear = velocity.head<3>();
+    const base::Vector3d angular = velocity.tail<3>();
+    const bool coriolis = model_type != SIMPLE;
+
+    for(size_t k = 0; k < n; k++)
+    {
+        size_t i = structure == FULL_MATRICES ? k / 6 : k;
+        size_t j = structure == FULL_MATRICES ? k % 6 : k;
+
+        /** Inertia entry M(i,j)
+         *  M*a contributes e_i*a_j.
+         *  Coriolis effect = -[p_l X w; p_l X v_l + p_a X w], p = M*v, contributes for p = e_i*v_j
+         */
+        base::Vector6d column = base::Vector6d::Zero();
+        column[i] = acceleration[j];
+        if(coriolis)
+        {
+            if(i < 3)
+            {
+                base::Vector3d e = base::Vector3d::Unit(i);
+                column.head<3>() -= e.cross(angular) * velocity[j];
+                column.tail<3>() -= e.cross(linear) * velocity[j];
+            }
+            else
+                column.tail<3>() -= base::Vector3d::Unit(i - 3).cross(angular) * velocity[j];
+        }
+        rows.col(k) = column;
+
+        /** Damping entries D_m(i,j)
+         *  SIMPLE and INTERMEDIATE: D_0*v + D_1*|v|*v
+         *  COMPLEX: sum(D_m*|v_m|)*v
+         */
+        for(size_t m = 0; m < getDampingMatrixCount(); m++)
+        {
+            double factor;
+            if(model_type == COMPLEX)
+                factor = std::abs(velocity[m]);
+            else
+                factor = m == 0 ? 1 : std::abs(velocity[j]);
+            base::Vector6d damping = base::Vector6d::Zero();
+            damping[i] = factor * velocity[j];
+            rows.col((m + 1) * n + k) = damping;
+        }
+    }
+
+    /** Restoring terms
+     *  [R^T*e3*(W-B); (cg*W - cb*B) X R^T*e3]
+     */
+    const size_t offset = (1 + getDampingMatrixCount()) * n;
+    const base::Vector3d world_z = context.worldZInBody();
+    rows.col(offset).setZero();
+    rows.col(offset).head<3>() = world_z;
+    for(size_t m = 0; m < 3; m++)
+    {
+        rows.col(offset + 1 + m).setZero();
+        rows.col(offset + 1 + m).tail<3>() = base::Vector3d::Unit(m).cross(world_z);
+    }
+}
+
+base::VectorXd ParameterIdentification::toParameterVector(const UWVParameters &parameters) const
+{
+    if(parameters.model_type != model_type || parameters.damping_matrices.size() != getDampingMatrixCount())
+        throw std::invalid_argument("ParameterIdentification: parameters do not match the identified model type");
+
+    const size_t n = getMatrixParameterCount();
+    base::VectorXd theta(getParameterCount());
+    for(size_t k = 0; k < n; k++)
+    {
+        size_t i = structure == FULL_MATRICES ? k / 6 : k;
+        size_t j = structure == FULL_MATRICES ? k % 6 : k;
+        theta[k] = parameters.inertia_matrix(i, j);
+        for(size_t m = 0; m < getDampingMatrixCount(); m++)
+            theta[(m + 1) * n + k] = parameters.damping_matrices[m](i, j);
+    }
+    const size_t offset = (1 + getDampingMatrixCount()) * n;
+    theta[offset] = parameters.weight - parameters.buoyancy;
+    theta.segment<3>(offset + 1) = parameters.distance_body2centerofgravity * parameters.weight -
+            parameters.distance_body2centerofbuoyancy * parameters.buoyancy;
+    return theta;
+}
+
+void ParameterIdentification::addSample(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+        const base::Orientation &orientation, const base::Vector6d &efforts)
+{
+    const size_t p = getParameterCount();
+    base::MatrixXd rows(6, p + 1);
+    fillRegressor(acceleration, velocity, EvaluationContext(orientation), rows);
+    rows.col(p) = efforts;
+    buffer.block(6 * buffered_samples, 0, 6, p + 1) = rows;
+    buffered_samples++;
+    sample_count++;
+    if(buffered_samples == BLOCK_SAMPLES)
+        flushBuffer();
+}
+
+void ParameterIdentification::addSamples(const std::vector<base::Vector6d> &accelerations,
+        const std::vector<base::Vector6d> &velocities, const std::vector<base::Orientation> &orientations,
+        const std::vector<base::Vector6d> &efforts, unsigned int n_threads)
+{
+    if(velocities.size() != accelerations.size() || orientations.size() != accelerations.size() ||
+            efforts.size() != accelerations.size())
+        throw std::invalid_argument("ParameterIdentification: all sample vectors must have the same size");
+    addSamples(VectorSource(accelerations, velocities, orientations, efforts), accelerations.size(), n_threads);
+}
+
+void ParameterIdentification::addSamples(const TrajectoryReader &trajectory, unsigned int n_threads)
+{
+    addSamples(TrajectorySource(trajectory), trajectory.size(), n_threads);
+}
+
+template<class Source>
+void ParameterIdentification::addSamples(const Source &source, size_t n, unsigned int n_threads)
+{
+    flushBuffer();
+
+    // Contiguous ranges, one per thread, each folded into its own factor
+    size_t n_chunks = getThreadCount(n_threads, (n + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES);
+    std::vector<base::MatrixXd> factors(n_chunks);
+    parallelFor(n_chunks, n_chunks, [&](size_t chunk)
+    {
+        factors[chunk] = base::MatrixXd::Zero(getParameterCount() + 1, getParameterCount() + 1);
+        foldSamples(source, n * chunk / n_chunks, n * (chunk + 1) / n_chunks, factors[chunk]);
+    });
+
+    for(size_t chunk = 0; chunk < n_chunks; chunk++)
+        fold(factor, factors[chunk]);
+    sample_count += n;
+}
+
+template<class Source>
+void ParameterIdentification::foldSamples(const Source &source, size_t begin, size_t end, base::MatrixXd &chunk_factor) const
+{
+    const size_t p = getParameterCount();
+    base::MatrixXd rows(6 * BLOCK_SAMPLES, p + 1);
+    base::MatrixXd sample_rows(6, p + 1);
+    base::Vector6d acceleration, velocity, effort;
+    base::Orientation orientation;
+
+    for(size_t block_begin = begin; block_begin < end; block_begin += BLOCK_SAMPLES)
+    {
+        size_t block_size = std::min(BLOCK_SAMPLES, end - block_begin);
+        for(size_t s = 0; s < block_size; s++)
+        {
+            source.get(block_begin + s, acceleration, velocity, orientation, effort);
+            fillRegressor(acceleration, velocity, EvaluationContext(orientation), sample_rows);
+            sample_rows.col(p) = effort;
+            rows.middleRows(6 * s, 6) = sample_rows;
+        }
+        fold(chunk_factor, rows.topRows(6 * block_size));
+    }
+}
+
+void ParameterIdentification::fold(base::MatrixXd &current_factor, const base::MatrixXd &rows) const
+{
+    const size_t p = getParameterCount() + 1;
+    base::MatrixXd stacked(p + rows.rows(), p);
+    stacked << current_factor, rows;
+    Eigen::HouseholderQR<base::MatrixXd> qr(stacked);
+    current_factor = qr.matrixQR().topRows(p).triangularView<Eigen::Upper>();
+}
+
+void ParameterIdentification::flushBuffer()
+{
+    if(buffered_samples == 0)
+        return;
+    fold(factor, buffer.topRows(6 * buffered_samples));
+    buffered_samples = 0;
+}
+
+size_t ParameterIdentification::getSampleCount() const
+{
+    return sample_count;
+}
+
+base::VectorXd ParameterIdentification::solve()
+{
+    flushBuffer();
+    const size_t p = getParameterCount();
+    Eigen::JacobiSVD<base::MatrixXd> svd(factor.topLeftCorner(p, p), Eigen::ComputeThinU | Eigen::ComputeThinV);
+    return svd.solve(factor.col(p).head(p));
+}
+
+double ParameterIdentification::getResidualRMS()
+{
+    if(sample_count == 0)
+        return 0;
+    base::VectorXd theta = solve();
+    const size_t p = getParameterCount();
+    double squared_norm = factor(p, p) * factor(p, p) +
+            (factor.topLeftCorner(p, p) * theta - factor.col(p).head(p)).squaredNorm();
+    return std::sqrt(squared_norm / (6 * sample_count));
+}
+
+UWVParameters ParameterIdentification::getUWVParameters(double weight, const base::Vector3d &distance_body2centerofgravity)
+{
+    base::VectorXd theta = solve();
+    const size_t n = getMatrixParameterCount();
+
+    UWVParameters parameters;
+    parameters.model_type = model_type;
+    parameters.inertia_matrix = base::Matrix6d::Zero();
+    parameters.damping_matrices.resize(getDampingMatrixCount());
+    for(size_t m = 0; m < parameters.damping_matrices.size(); m++)
+        parameters.damping_matrices[m] = base::Matrix6d::Zero();
+
+    for(size_t k = 0; k < n; k++)
+    {
+        size_t i = structure == FULL_MATRICES ? k / 6 : k;
+        size_t j = structure == FULL_MATRICES ? k % 6 : k;
+        parameters.inertia_matrix(i, j) = theta[k];
+        for(size_t m = 0; m < parameters.damping_matrices.size(); m++)
+            parameters.damping_matrices[m](i, j) = theta[(m + 1) * n + k];
+    }
+
+    const size_t offset = (1 + getDampingMatrixCount()) * n;
+    parameters.weight = weight;
+    parameters.buoyancy = weight - theta[offset];
+    if(parameters.buoyancy <= 0)
+        throw std::runtime_error("ParameterIdentification: identified buoyancy is not positive for the given weight");
+    parameters.distance_body2centerofgravity = distance_body2centerofgravity;
+    parameters.distance_body2centerofbuoyancy = (distance_body2centerofgravity * weight -
+            base::Vector3d(theta.segment<3>(offset + 1))) / parameters.buoyancy;
+    return parameters;
+}
+
+void ParameterIdentification::reset()
+{
+    const size_t p = getParameterCount() + 1;
+    factor = base::MatrixXd::Zero(p, p);
+    buffer = base::MatrixXd::Zero(6 * BLOCK_SAMPLES, p);
+    buffered_samples = 0;
+    sample_count = 0;
+}
+};
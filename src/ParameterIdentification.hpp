@@ -0,0 +1,187 @@
+#ifndef _PARAMETER_IDENTIFICATION_H_
+#define _PARAMETER_IDENTIFICATION_H_
+
+#include "DataTypes.hpp"
+#include "EvaluationContext.hpp"
+#include "TrajectoryReader.hpp"
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/** Define which entries of the inertia and damping matrices are identified.
+ *
+ * Full_Matrices:
+ * All 36 entries of each matrix.
+ *
+ * Diagonal_Matrices:
+ * Only the 6 diagonal entries of each matrix, the others being zero.
+ */
+enum MatrixStructure
+{
+    FULL_MATRICES,
+    DIAGONAL_MATRICES
+};
+
+/**********************************************************
+ * Parameter Identification
+ * Least squares fit of UWVParameters to logged samples.
+ *
+ * The efforts computed by DynamicModel::calcEfforts are linear in the
+ * entries of the inertia and damping matrices and in the restoring terms:
+ *  efforts = Y(acceleration, velocity, orientation) * theta
+ * with theta = [inertia entries; damping entries of each matrix; W-B; cg*W - cb*B]
+ * (matrix entries in row-major order).
+ *
+ * Each sample adds six rows to the regression. Rows are folded into the
+ * triangular factor of a QR decomposition block by block, so the memory
+ * does not depend on the number of samples. Batches of samples are split
+ * between threads, each one folding its rows into its own factor, and the
+ * factors are merged at the end of the batch.
+ **********************************************************/
+class ParameterIdentification
+{
+public:
+    /** Constructor
+     *
+     *  @param model_type model to identify
+     *  @param structure identified matrix entries
+     */
+    ParameterIdentification(ModelType model_type = SIMPLE, MatrixStructure structure = FULL_MATRICES);
+
+    ~ParameterIdentification();
+
+    /** Get number of identified parameters
+     *
+     *  @return size of theta
+     */
+    size_t getParameterCount() const;
+
+    /** Compute the regressor of one sample
+     *
+     *  @param acceleration linear/angular acceleration in body frame
+     *  @param velocity linear/angular velocity in body frame
+     *  @param orientation
+     *  @return 6 x getParameterCount() matrix
+     */
+    base::MatrixXd calcRegressor(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+                                 const base::Orientation &orientation) const;
+
+    /** Compute the parameter vector of a parameter set
+     *
+     *  Entries not identified with the chosen structure are ignored.
+     *  @param parameters
+     *  @return theta
+     */
+    base::VectorXd toParameterVector(const UWVParameters &parameters) const;
+
+    /** Add one sample
+     *
+     *  Samples are buffered and folded into the decomposition by blocks.
+     *  @param acceleration linear/angular acceleration in body frame
+     *  @param velocity linear/angular velocity in body frame
+     *  @param orientation
+     *  @param efforts applied forces and torques in body frame
+     */
+    void addSample(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+                   const base::Orientation &orientation, const base::Vector6d &efforts);
+
+    /** Add a batch of samples, in parallel
+     *
+     *  @param accelerations
+     *  @param velocities
+     *  @param orientations
+     *  @param efforts
+     *  @param n_threads number of threads. 0 for the number of cores.
+     */
+    void addSamples(const std::vector<base::Vector6d> &accelerations, const std::vector<base::Vector6d> &velocities,
+                    const std::vector<base::Orientation> &orientations, const std::vector<base::Vector6d> &efforts,
+                    unsigned int n_threads = 0);
+
+    /** Add all the samples of a trajectory file, in parallel
+     *
+     *  @param trajectory recorded trajectory (see TrajectoryFormat.hpp)
+     *  @param n_threads number of threads. 0 for the number of cores.
+     */
+    void addSamples(const TrajectoryReader &trajectory, unsigned int n_threads = 0);
+
+    /** Get number of samples added so far
+     *
+     *  @return number of samples
+     */
+    size_t getSampleCount() const;
+
+    /** Solve the least squares problem
+     *
+     *  Parameters that the samples do not excite get the minimum norm solution.
+     *  @return theta
+     */
+    base::VectorXd solve();
+
+    /** Root mean square of the effort residuals of the last solution
+     *
+     *  @return residual [N or Nm]
+     */
+    double getResidualRMS();
+
+    /** Convert the solution to UWVParameters
+     *
+     *  Weight and buoyancy, and the centers of gravity and buoyancy, are not
+     *  separable from the efforts: only W-B and cg*W - cb*B are identified.
+     *  The buoyancy and the center of buoyancy are derived from the given
+     *  weight and center of gravity.
+     *  @param weight of the vehicle
+     *  @param distance_body2centerofgravity
+     *  @return parameters
+     */
+    UWVParameters getUWVParameters(double weight, const base::Vector3d &distance_body2centerofgravity);
+
+    /** Discard all samples
+     *
+     */
+    void reset();
+
+private:
+    /**
+     * Add the columns of one sample to a 6 row block of the regression
+     */
+    void fillRegressor(const base::Vector6d &acceleration, const base::Vector6d &velocity,
+                       const EvaluationContext &context, base::MatrixXd &rows) const;
+
+    /**
+     * Fold the samples [begin, end) of a source into a triangular factor
+     */
+    template<class Source>
+    void foldSamples(const Source &source, size_t begin, size_t end, base::MatrixXd &factor) const;
+
+    template<class Source>
+    void addSamples(const Source &source, size_t n, unsigned int n_threads);
+
+    /**
+     * Replace factor by the triangular factor of [factor; rows]
+     */
+    void fold(base::MatrixXd &factor, const base::MatrixXd &rows) const;
+
+    void flushBuffer();
+
+    size_t getMatrixParameterCount() const;
+    size_t getDampingMatrixCount() const;
+
+    ModelType model_type;
+    MatrixStructure structure;
+
+    /**
+     * Upper triangular factor R of the augmented regression [Y efforts].
+     * The last column holds Q^T*efforts, its last diagonal element the residual norm.
+     */
+    base::MatrixXd factor;
+
+    /**
+     * Rows of the samples added one by one, not yet folded
+     */
+    base::MatrixXd buffer;
+    size_t buffered_samples;
+
+    size_t sample_count;
+};
+};
+#endif
@@ -0,0 +1,111 @@
+#include "Parareal.hpp"
+#include "ParallelFor.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+Parareal::Parareal(const ModelSimulation &simulation, IntegrationScheme coarse_scheme)
+    : simulation(simulation), coarse(simulation.getModelSimulator(), simulation.getSamplingTime(), 1),
+      tolerance(1e-8), max_iterations(0), iterations(0), start_time(0)
+{
+    coarse.setIntegrationScheme(coarse_scheme);
+    // Cheap integration, even where the fine propagator is exact
+    coarse.setExactDiscretization(false);
+}
+
+Parareal::~Parareal()
+{
+}
+
+void Parareal::setTolerance(double tolerance)
+{
+    if(tolerance < 0)
+        throw std::invalid_argument("Parareal: tolerance must be positive or equal to zero");
+    this->tolerance = tolerance;
+}
+
+void Parareal::setMaxIterations(unsigned int iterations)
+{
+    max_iterations = iterations;
+}
+
+unsigned int Parareal::getIterations() const
+{
+    return iterations;
+}
+
+PoseVelocityState Parareal::simulateSlice(const ModelSimulation &propagator, const PoseVelocityState &state,
+        const std::vector<base::Vector6d> &controls, size_t begin, size_t end,
+        std::vector<PoseVelocityState> *trajectory) const
+{
+    PoseVelocityState next = state;
+    for(size_t i = begin; i < end; i++)
+    {
+        next = propagator.simulateCycle(next, controls[i], start_time + i * simulation.getSamplingTime());
+        if(trajectory)
+            (*trajectory)[i] = next;
+    }
+    return next;
+}
+
+std::vector<PoseVelocityState> Parareal::simulate(const PoseVelocityState &initial_state,
+        const std::vector<base::Vector6d> &controls, unsigned int n_threads, unsigned int n_slices)
+{
+    iterations = 0;
+    if(simulation.hasInputStage())
+        throw std::invalid_argument("Parareal: input delay and rate limit are not supported");
+    const size_t n = controls.size();
+    std::vector<PoseVelocityState> trajectory(n);
+    if(n == 0)
+        return trajectory;
+
+    coarse.setSamplingTime(simulation.getSamplingTime());
+    coarse.setUWVParameters(simulation.getUWVParameters());
+    coarse.setCurrentField(simulation.getCurrentField());
+    start_time = simulation.getCurrentTime();
+
+    const size_t n_slice = n_slices ? std::min<size_t>(n_slices, n) : getThreadCount(n_threads, n);
+    std::vector<size_t> bounds(n_slice + 1);
+    for(size_t s = 0; s <= n_slice; s++)
+        bounds[s] = s * n / n_slice;
+
+    // Coarse prediction of the slice starts
+    std::vector<PoseVelocityState> starts(n_slice + 1, initial_state);
+    std::vector<PoseVelocityState> coarse_ends(n_slice);
+    std::vector<PoseVelocityState> fine_ends(n_slice);
+    for(size_t s = 0; s < n_slice; s++)
+    {
+        coarse_ends[s] = simulateSlice(coarse, starts[s], controls, bounds[s], bounds[s + 1], NULL);
+        starts[s + 1] = coarse_ends[s];
+    }
+
+    const size_t last_iteration = max_iterations ? std::min<size_t>(max_iterations, n_slice) : n_slice;
+    for(size_t k = 0; k < last_iteration; k++)
+    {
+        // Slices before k start from exact states and were already simulated
+        parallelFor(n_slice - k, n_threads, [&](size_t i)
+        {
+            size_t s = k + i;
+            fine_ends[s] = simulateSlice(simulation, starts[s], controls, bounds[s], bounds[s + 1], &trajectory);
+        });
+        iterations++;
+
+        // The slice k started from an exact state, its fine end is the next exact start
+        double correction = (toStateVector(fine_ends[k]) - toStateVector(starts[k + 1])).lpNorm<Eigen::Infinity>();
+        starts[k + 1] = fine_ends[k];
+        for(size_t s = k + 1; s < n_slice; s++)
+        {
+            PoseVelocityState coarse_end = simulateSlice(coarse, starts[s], controls, bounds[s], bounds[s + 1], NULL);
+            base::VectorXd start = toStateVector(coarse_end) + toStateVector(fine_ends[s]) - toStateVector(coarse_ends[s]);
+            correction = std::max(correction, (start - toStateVector(starts[s + 1])).lpNorm<Eigen::Infinity>());
+            coarse_ends[s] = coarse_end;
+            starts[s + 1] = fromStateVector(start);
+            starts[s + 1].orientation.normalize();
+        }
+        if(correction <= tolerance)
+            break;
+    }
+    return trajectory;
+}
+};
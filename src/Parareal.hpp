@@ -0,0 +1,93 @@
+#ifndef _PARAREAL_H_
+#define _PARAREAL_H_
+
+#include "ModelSimulation.hpp"
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/**********************************************************
+ * Parareal
+ * Parallel-in-time simulation of a schedule of efforts, for long open-loop
+ * runs.
+ *
+ * The horizon is split into time slices. A cheap coarse propagator (one
+ * step of the coarse scheme per sampling period, never the exact
+ * discretization, in the current field of the simulation) predicts the
+ * state at the start of every slice serially, then each iteration simulates all the
+ * slices in parallel with the fine propagator (ModelSimulation::simulateCycle)
+ * and corrects the predictions:
+ *  U[s+1] = G(U[s]) + F(U_previous[s]) - G(U_previous[s])
+ * After k iterations the first k slices are exact, so the result matches the
+ * serial simulation after at most one iteration per slice. Iterations stop
+ * earlier once the correction of every slice start is below the tolerance.
+ **********************************************************/
+class Parareal
+{
+public:
+    /** Constructor
+     *
+     *  @param simulation fine propagator. Its parameters are read at each simulate.
+     *                    Must outlive the Parareal.
+     *  @param coarse_scheme integration scheme of the coarse propagator
+     */
+    Parareal(const ModelSimulation &simulation, IntegrationScheme coarse_scheme = RUNGE_KUTTA_4);
+
+    ~Parareal();
+
+    /** Set convergence tolerance
+     *
+     *  @param tolerance on the largest correction of a slice start state (see toStateVector)
+     */
+    void setTolerance(double tolerance);
+
+    /** Set maximum number of iterations
+     *
+     *  @param iterations 0 for one per slice, i.e. until the result is exact
+     */
+    void setMaxIterations(unsigned int iterations);
+
+    /** Simulate a schedule of efforts
+     *
+     *  Same result as sendEffort with each control input, within the
+     *  tolerance, the events of the simulation being ignored. The schedule
+     *  starts at the current time of the simulation. Throws
+     *  std::invalid_argument if the simulation has an input delay or rate
+     *  limit, which simulateCycle does not support.
+     *  @param initial_state
+     *  @param controls efforts of each sampling period
+     *  @param n_threads number of threads. 0 for the number of cores.
+     *  @param n_slices number of time slices. 0 for the number of threads.
+     *  @return state at the end of each sampling period
+     */
+    std::vector<PoseVelocityState> simulate(const PoseVelocityState &initial_state,
+                                            const std::vector<base::Vector6d> &controls,
+                                            unsigned int n_threads = 0, unsigned int n_slices = 0);
+
+    /** Iterations of the last simulate
+     *
+     *  @return number of fine sweeps
+     */
+    unsigned int getIterations() const;
+
+private:
+    /**
+     * Simulate the cycles [begin, end) from state, recording the states if trajectory is not NULL
+     */
+    PoseVelocityState simulateSlice(const ModelSimulation &propagator, const PoseVelocityState &state,
+                                    const std::vector<base::Vector6d> &controls, size_t begin, size_t end,
+                                    std::vector<PoseVelocityState> *trajectory) const;
+
+    const ModelSimulation &simulation;
+    ModelSimulation coarse;
+    double tolerance;
+    unsigned int max_iterations;
+    unsigned int iterations;
+
+    /**
+     * Time at the start of the schedule
+     */
+    double start_time;
+};
+};
+#endif
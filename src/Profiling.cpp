@@ -0,0 +1,53 @@
+#include "Profiling.hpp"
+
+namespace uwv_dynamic_model
+{
+bool isProfilingEnabled()
+{
+#ifdef UWV_DYNAMIC_MODEL_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* getProfiledTermName(ProfiledTerm term)
+{
+    switch(term)
+    {
+    case PROFILE_GRAVITY_BUOYANCY:
+        return "gravity_buoyancy";
+    case PROFILE_CORIOLIS:
+        return "coriolis";
+    case PROFILE_SIMPLE_DAMPING:
+        return "simple_damping";
+    case PROFILE_GENERAL_QUAD_DAMPING:
+        return "general_quad_damping";
+    case PROFILE_INVERSE_INERTIA_PRODUCT:
+        return "inverse_inertia_product";
+    case PROFILE_INERTIA_INVERSION:
+        return "inertia_inversion";
+    case PROFILE_KINEMATICS:
+        return "kinematics";
+    case PROFILE_RK4_STAGES:
+        return "rk4_stages";
+    default:
+        return "unknown";
+    }
+}
+
+std::ostream& operator<< (std::ostream &stream, const ProfileStats &stats)
+{
+    static const char* model_names[] = {"SIMPLE", "COMPLEX", "INTERMEDIATE"};
+    stream << "model_type " << model_names[stats.model_type] << std::endl;
+    for(size_t i = 0; i < PROFILE_TERM_COUNT; i++)
+    {
+        stream << getProfiledTermName(ProfiledTerm(i))
+                << " calls " << stats.calls[i]
+                << " cycles " << stats.cycles[i]
+                << " cycles/call " << (stats.calls[i] ? double(stats.cycles[i]) / stats.calls[i] : 0.)
+                << std::endl;
+    }
+    return stream;
+}
+};
@@ -0,0 +1,171 @@
+#ifndef _PROFILING_H_
+#define _PROFILING_H_
+
+#include "DataTypes.hpp"
+#include <ostream>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+namespace uwv_dynamic_model
+{
+/**
+ * Hot-path instrumentation
+ *
+ * When the library is built with UWV_DYNAMIC_MODEL_PROFILING defined
+ * (cmake -DPROFILING=ON), the model terms count their calls and the cycles
+ * spent in them. The counters are accumulated in the ProfileStats of the
+ * ModelSimulation being stepped by the calling thread.
+ * Without the definition the instrumentation compiles to nothing.
+ */
+enum ProfiledTerm
+{
+    PROFILE_GRAVITY_BUOYANCY,
+    PROFILE_CORIOLIS,
+    PROFILE_SIMPLE_DAMPING,
+    PROFILE_GENERAL_QUAD_DAMPING,
+    PROFILE_INVERSE_INERTIA_PRODUCT,
+    PROFILE_INERTIA_INVERSION,
+    PROFILE_KINEMATICS,
+    PROFILE_RK4_STAGES,
+    PROFILE_TERM_COUNT
+};
+
+struct ProfileStats
+{
+    /**
+     * Model type of the profiled simulation
+     */
+    ModelType model_type;
+
+    /**
+     * Number of calls per ProfiledTerm
+     */
+    uint64_t calls[PROFILE_TERM_COUNT];
+
+    /**
+     * Cycles (or nanoseconds where no cycle counter is available) per ProfiledTerm
+     */
+    uint64_t cycles[PROFILE_TERM_COUNT];
+
+    ProfileStats():
+        model_type(SIMPLE)
+    {
+        reset();
+    }
+
+    inline void reset()
+    {
+        for(size_t i = 0; i < PROFILE_TERM_COUNT; i++)
+        {
+            calls[i] = 0;
+            cycles[i] = 0;
+        }
+    }
+
+    inline ProfileStats& operator+= (const ProfileStats &value)
+    {
+        for(size_t i = 0; i < PROFILE_TERM_COUNT; i++)
+        {
+            calls[i] += value.calls[i];
+            cycles[i] += value.cycles[i];
+        }
+        return *this;
+    }
+};
+
+/** Whether the library was built with UWV_DYNAMIC_MODEL_PROFILING
+ *
+ */
+bool isProfilingEnabled();
+
+/** Name of a profiled term
+ *
+ */
+const char* getProfiledTermName(ProfiledTerm term);
+
+/** Dump the counters, one term per line
+ *
+ */
+std::ostream& operator<< (std::ostream &stream, const ProfileStats &stats);
+
+inline uint64_t readCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+#endif
+}
+
+/** Stats receiving the counters of the calling thread
+ *
+ */
+inline ProfileStats*& currentProfileStats()
+{
+    static thread_local ProfileStats *stats = NULL;
+    return stats;
+}
+
+/** Accumulate the cycles spent in a scope
+ *
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfiledTerm term):
+        term(term), start(readCycleCounter())
+    {
+    }
+
+    ~ProfileScope()
+    {
+        ProfileStats *stats = currentProfileStats();
+        if(stats)
+        {
+            stats->calls[term]++;
+            stats->cycles[term] += readCycleCounter() - start;
+        }
+    }
+
+private:
+    ProfiledTerm term;
+    uint64_t start;
+};
+
+/** Direct the counters of the calling thread to a ProfileStats for the lifetime of the guard
+ *
+ */
+class ProfileStatsGuard
+{
+public:
+    explicit ProfileStatsGuard(ProfileStats *stats):
+        previous(currentProfileStats())
+    {
+        currentProfileStats() = stats;
+    }
+
+    ~ProfileStatsGuard()
+    {
+        currentProfileStats() = previous;
+    }
+
+private:
+    ProfileStats *previous;
+};
+};
+
+#ifdef UWV_DYNAMIC_MODEL_PROFILING
+#define UWV_PROFILE_SCOPE(term) ::uwv_dynamic_model::ProfileScope uwv_profile_scope(term)
+#define UWV_PROFILE_STATS(stats) ::uwv_dynamic_model::ProfileStatsGuard uwv_profile_stats_guard(stats)
+#else
+#define UWV_PROFILE_SCOPE(term)
+#define UWV_PROFILE_STATS(stats)
+#endif
+
+#endif
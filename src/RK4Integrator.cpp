@@ -21,12 +21,68 @@
  */
 
 #include "RK4Integrator.hpp"
+#include "Profiling.hpp"
+#include "Linearization.hpp"
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 namespace uwv_dynamic_model
 {
+void getButcherTableau(IntegrationScheme scheme, const double *&c, const double *&b, size_t &n_stages)
+{
+    static const double rk4_c[] = {0, 0.5, 0.5, 1};
+    static const double rk4_b[] = {1./6, 1./3, 1./3, 1./6};
+    static const double heun_c[] = {0, 1};
+    static const double heun_b[] = {0.5, 0.5};
+    static const double euler_c[] = {0};
+    static const double euler_b[] = {1};
+    c = rk4_c;
+    b = rk4_b;
+    n_stages = 4;
+    if(scheme == HEUN)
+    {
+        c = heun_c;
+        b = heun_b;
+        n_stages = 2;
+    }
+    else if(scheme == EULER)
+    {
+        c = euler_c;
+        b = euler_b;
+        n_stages = 1;
+    }
+}
+
+DenseOutputStep::DenseOutputStep()
+    : step(0), scheme(RUNGE_KUTTA_4)
+{
+}
+
+PoseVelocityState DenseOutputStep::interpolate(double theta) const
+{
+    // Continuous extensions of the schemes: state + step * sum(b_i(theta) * k_i), b_i(1) being the weights
+    PoseVelocityState state;
+    double theta2 = theta * theta;
+    if(scheme == EULER)
+        state = start + (step * theta) * stages[0];
+    else if(scheme == HEUN)
+        state = start + (step * (theta - theta2 / 2)) * stages[0] + (step * theta2 / 2) * stages[1];
+    else
+    {
+        double theta3 = theta2 * theta;
+        double b_middle = theta2 - 2 * theta3 / 3;
+        state = start + (step * (theta - 3 * theta2 / 2 + 2 * theta3 / 3)) * stages[0] +
+                (step * b_middle) * (stages[1] + stages[2]) +
+                (step * (-theta2 / 2 + 2 * theta3 / 3)) * stages[3];
+    }
+    // Same extension for the quaternion, a slerp between the end points would assume a constant angular velocity
+    state.orientation.normalize();
+    return state;
+}
+
 RK4Integrator::RK4Integrator(double step)
-:    integration_step(step)
+:    integration_step(step), integration_scheme(RUNGE_KUTTA_4)
 {
     checkStep(step);
 }
@@ -34,30 +90,231 @@ RK4Integrator::RK4Integrator(double step)
 RK4Integrator::~RK4Integrator()
 {}
 
-PoseVelocityState RK4Integrator::calcStates(const PoseVelocityState &states, const base::Vector6d &control_input)
+PoseVelocityState RK4Integrator::calcStates(const PoseVelocityState &states, const base::Vector6d &control_input) const
+{
+    return calcStates(states, control_input, control_input, control_input);
+}
+
+PoseVelocityState RK4Integrator::calcStates(const PoseVelocityState &states, const base::Vector6d &start_input,
+        const base::Vector6d &middle_input, const base::Vector6d &end_input) const
+{
+    return calcStep(states, start_input, middle_input, end_input, NULL);
+}
+
+PoseVelocityState RK4Integrator::calcStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+        DenseOutputStep &dense_output) const
+{
+    return calcStep(states, control_input, control_input, control_input, &dense_output);
+}
+
+PoseVelocityState RK4Integrator::calcStep(const PoseVelocityState &states, const base::Vector6d &start_input,
+        const base::Vector6d &middle_input, const base::Vector6d &end_input, DenseOutputStep *dense_output,
+        const CurrentEnvironment *current) const
+{
+    checkInputs(states, start_input);
+    checkInputs(states, middle_input);
+    checkInputs(states, end_input);
+    PoseVelocityState *stages = dense_output ? dense_output->stages : NULL;
+    PoseVelocityState system_states;
+    switch(integration_scheme)
+    {
+    case EULER:
+        system_states = calcEulerStep(states, start_input, stages, current);
+        break;
+    case HEUN:
+        system_states = calcHeunStep(states, start_input, end_input, stages, current);
+        break;
+    default:
+        system_states = calcRK4Step(states, start_input, middle_input, end_input, stages, current);
+        break;
+    }
+
+    //Brute force normalization of quaternions due the integration.
+    system_states.orientation.normalize();
+
+    if(dense_output)
+    {
+        dense_output->start = states;
+        dense_output->start.orientation.normalize();
+        dense_output->end = system_states;
+        dense_output->step = integration_step;
+        dense_output->scheme = integration_scheme;
+    }
+    return system_states;
+}
+
+PoseVelocityState RK4Integrator::calcStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+        base::MatrixXd &sensitivity) const
 {
     checkInputs(states, control_input);
-    PoseVelocityState system_states = states;
+    if(size_t(sensitivity.rows()) != LINEAR_STATE_SIZE)
+        throw std::invalid_argument("uwv_dynamic_model: RK4Integrator.cpp: sensitivity matrix must have 13 rows.");
 
-    // Runge-Kuta coefficients
-    PoseVelocityState k1 = deriv(system_states, control_input);
-    PoseVelocityState k2 = deriv(system_states + ((integration_step/2)*k1), control_input);
-    PoseVelocityState k3 = deriv(system_states + ((integration_step/2)*k2), control_input);
-    PoseVelocityState k4 = deriv(system_states + (integration_step*k3), control_input);
+    const double *c, *b;
+    size_t n_stages;
+    getButcherTableau(integration_scheme, c, b, n_stages);
 
-    // Calculating the system states
-    system_states += (integration_step/6)*(k1 + 2*k2 + 2*k3 + k4);
+    PoseVelocityState k = 0 * states;
+    PoseVelocityState state_increment = 0 * states;
+    base::MatrixXd sensitivity_k = base::MatrixXd::Zero(sensitivity.rows(), sensitivity.cols());
+    base::MatrixXd sensitivity_increment = sensitivity_k;
+    for(size_t i = 0; i < n_stages; i++)
+    {
+        PoseVelocityState stage_states = states + (integration_step * c[i]) * k;
+        base::MatrixXd stage_sensitivity = sensitivity + (integration_step * c[i]) * sensitivity_k;
+        k = deriv(stage_states, control_input);
+        sensitivity_k = sensitivityDeriv(stage_states, control_input, stage_sensitivity);
+        state_increment += b[i] * k;
+        sensitivity_increment += b[i] * sensitivity_k;
+    }
+    PoseVelocityState system_states = states + integration_step * state_increment;
+    sensitivity += integration_step * sensitivity_increment;
 
-    //Brute force normalization of quaternions due the RK4 integration.
+    // Normalization of the quaternion: d(q/|q|) = (I - q*q^T/|q|^2)/|q| * dq
+    const Eigen::Vector4d q = system_states.orientation.coeffs();
+    const double norm = q.norm();
+    Eigen::Matrix4d normalization = (Eigen::Matrix4d::Identity() - q * q.transpose() / (norm * norm)) / norm;
+    sensitivity.middleRows(3, 4) = normalization * sensitivity.middleRows(3, 4);
     system_states.orientation.normalize();
 
     return system_states;
 }
 
-PoseVelocityState RK4Integrator::deriv(const PoseVelocityState &current_states, const base::Vector6d &control_input)
+PoseVelocityState RK4Integrator::calcMultiRateStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+        unsigned int n_steps, const CurrentEnvironment *current) const
+{
+    checkInputs(states, control_input);
+    if(n_steps == 0)
+        throw std::invalid_argument("uwv_dynamic_model: RK4Integrator.cpp: multi-rate step needs at least one velocity step.");
+
+    const double *c, *b;
+    size_t n_stages;
+    getButcherTableau(integration_scheme, c, b, n_stages);
+
+    // Velocities at the integration step, pose and frame conversions held
+    const EvaluationContext context(states.orientation, current);
+    std::vector<base::Vector6d> velocities(n_steps + 1);
+    velocities[0] << states.linear_velocity, states.angular_velocity;
+    PoseVelocityState stage_states = states;
+    for(size_t j = 0; j < n_steps; j++)
+    {
+        base::Vector6d k = base::Vector6d::Zero();
+        base::Vector6d increment = base::Vector6d::Zero();
+        for(size_t i = 0; i < n_stages; i++)
+        {
+            base::Vector6d stage_velocity = velocities[j] + (integration_step * c[i]) * k;
+            stage_states.linear_velocity = stage_velocity.head<3>();
+            stage_states.angular_velocity = stage_velocity.tail<3>();
+            PoseVelocityState velocity_deriv = velocityDeriv(stage_states, control_input, context);
+            k << velocity_deriv.linear_velocity, velocity_deriv.angular_velocity;
+            increment += b[i] * k;
+        }
+        velocities[j + 1] = velocities[j] + integration_step * increment;
+    }
+
+    // Pose over the whole interval, with the velocities linearly interpolated at the stage times
+    const double pose_step = n_steps * integration_step;
+    PoseVelocityState k = 0 * states;
+    PoseVelocityState increment = 0 * states;
+    for(size_t i = 0; i < n_stages; i++)
+    {
+        double position = c[i] * n_steps;
+        size_t j = std::min<size_t>(position, n_steps - 1);
+        base::Vector6d velocity = velocities[j] + (position - j) * (velocities[j + 1] - velocities[j]);
+        stage_states = states + (pose_step * c[i]) * k;
+        stage_states.linear_velocity = velocity.head<3>();
+        stage_states.angular_velocity = velocity.tail<3>();
+        k = poseDeriv(stage_states, EvaluationContext(stage_states.orientation));
+        increment += b[i] * k;
+    }
+    PoseVelocityState pose_states = states + pose_step * increment;
+    pose_states.linear_velocity = velocities[n_steps].head<3>();
+    pose_states.angular_velocity = velocities[n_steps].tail<3>();
+
+    //Brute force normalization of quaternions due the integration.
+    pose_states.orientation.normalize();
+    return pose_states;
+}
+
+base::MatrixXd RK4Integrator::sensitivityDeriv(const PoseVelocityState &/*current_states*/,
+        const base::Vector6d &/*control_input*/, const base::MatrixXd &/*sensitivity*/) const
+{
+    throw std::runtime_error("uwv_dynamic_model: RK4Integrator.cpp: sensitivities are not supported by this integrator.");
+}
+
+PoseVelocityState RK4Integrator::calcRK4Step(const PoseVelocityState &system_states, const base::Vector6d &start_input,
+        const base::Vector6d &middle_input, const base::Vector6d &end_input, PoseVelocityState *stages,
+        const CurrentEnvironment *current) const
+{
+    // Runge-Kuta coefficients
+    PoseVelocityState stage_states;
+    PoseVelocityState k1 = deriv(system_states, start_input, current);
+    {
+        UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+        stage_states = system_states + ((integration_step/2)*k1);
+    }
+    PoseVelocityState k2 = deriv(stage_states, middle_input, current);
+    {
+        UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+        stage_states = system_states + ((integration_step/2)*k2);
+    }
+    PoseVelocityState k3 = deriv(stage_states, middle_input, current);
+    {
+        UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+        stage_states = system_states + (integration_step*k3);
+    }
+    PoseVelocityState k4 = deriv(stage_states, end_input, current);
+
+    UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+    if(stages)
+    {
+        stages[0] = k1;
+        stages[1] = k2;
+        stages[2] = k3;
+        stages[3] = k4;
+    }
+    // Calculating the system states
+    return system_states + (integration_step/6)*(k1 + 2*k2 + 2*k3 + k4);
+}
+
+PoseVelocityState RK4Integrator::calcHeunStep(const PoseVelocityState &system_states, const base::Vector6d &start_input,
+        const base::Vector6d &end_input, PoseVelocityState *stages, const CurrentEnvironment *current) const
 {
-    PoseVelocityState derivatives = poseDeriv(current_states);
-    PoseVelocityState vel_deriv = velocityDeriv(current_states, control_input);
+    PoseVelocityState stage_states;
+    PoseVelocityState k1 = deriv(system_states, start_input, current);
+    {
+        UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+        stage_states = system_states + (integration_step*k1);
+    }
+    PoseVelocityState k2 = deriv(stage_states, end_input, current);
+
+    UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+    if(stages)
+    {
+        stages[0] = k1;
+        stages[1] = k2;
+    }
+    return system_states + (integration_step/2)*(k1 + k2);
+}
+
+PoseVelocityState RK4Integrator::calcEulerStep(const PoseVelocityState &system_states, const base::Vector6d &control_input,
+        PoseVelocityState *stages, const CurrentEnvironment *current) const
+{
+    PoseVelocityState k1 = deriv(system_states, control_input, current);
+
+    UWV_PROFILE_SCOPE(PROFILE_RK4_STAGES);
+    if(stages)
+        stages[0] = k1;
+    return system_states + integration_step*k1;
+}
+
+PoseVelocityState RK4Integrator::deriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+        const CurrentEnvironment *current) const
+{
+    // Frame conversions shared by all the terms of this evaluation
+    EvaluationContext context(current_states.orientation, current);
+    PoseVelocityState derivatives = poseDeriv(current_states, context);
+    PoseVelocityState vel_deriv = velocityDeriv(current_states, control_input, context);
     derivatives.linear_velocity = vel_deriv.linear_velocity;
     derivatives.angular_velocity = vel_deriv.angular_velocity;
     return derivatives;
@@ -69,13 +326,23 @@ void RK4Integrator::setIntegrationStep(const double step)
     integration_step = step;
 }
 
-void RK4Integrator::checkStep(double step)
+void RK4Integrator::setIntegrationScheme(IntegrationScheme scheme)
+{
+    integration_scheme = scheme;
+}
+
+IntegrationScheme RK4Integrator::getIntegrationScheme() const
+{
+    return integration_scheme;
+}
+
+void RK4Integrator::checkStep(double step) const
 {
     if (step <= 0)
         throw std::runtime_error("uwv_dynamic_model: RK4Integrator.cpp: Integration step is equal or smaller than zero.");
 }
 
-void RK4Integrator::checkInputs(const PoseVelocityState &states, const base::Vector6d &control_input)
+void RK4Integrator::checkInputs(const PoseVelocityState &states, const base::Vector6d &control_input) const
 {
     if( states.hasNaN())
         throw std::runtime_error( "uwv_dynamic_model: RK4Integrator.cpp: The system states has a nan");
@@ -4,6 +4,8 @@
  * If the initial equation is in the form of n'th order differential equation
  * it must be converted to a system of n first order differential
  * equations.
+ * Lower order Euler and Heun schemes can be selected instead, e.g. for
+ * accuracy versus cost studies.
  *
  */
 
@@ -11,9 +13,52 @@
 #define RK4_INTEGRATOR_HPP
 
 #include "DataTypes.hpp"
+#include "EvaluationContext.hpp"
 
 namespace uwv_dynamic_model
 {
+/** Get the Butcher tableau of an explicit scheme
+ *
+ *  Stage i is evaluated at states + step*c[i]*k(i-1), the step weights the stages with b.
+ *  @param scheme
+ *  @param c stage times, static array
+ *  @param b stage weights, static array
+ *  @param n_stages number of stages
+ */
+void getButcherTableau(IntegrationScheme scheme, const double *&c, const double *&b, size_t &n_stages);
+
+/**
+ * Stages of one integration step, for interpolation inside the step
+ */
+struct DenseOutputStep
+{
+    /**
+     * States at the start and end of the step, normalized orientations
+     */
+    PoseVelocityState start;
+    PoseVelocityState end;
+
+    /**
+     * State derivatives of the stages, as many as the scheme has
+     */
+    PoseVelocityState stages[4];
+
+    double step;
+    IntegrationScheme scheme;
+
+    DenseOutputStep();
+
+    /** Interpolate the state inside the step
+     *
+     *  Continuous extension of the scheme from its stage derivatives (third
+     *  order for RUNGE_KUTTA_4), without new evaluations of the model. The
+     *  orientation is normalized. Exact at the end points.
+     *  @param theta normalized time in [0, 1]
+     *  @return state at start time + theta * step
+     */
+    PoseVelocityState interpolate(double theta) const;
+};
+
 class RK4Integrator
 {
 public:
@@ -29,40 +74,129 @@ public:
 
     /** Performs one step simulation.
      *
+     *  Does not modify the integrator, so one instance can be used from several threads.
      *  Particular case of state space representation. PoseVelocityState structure instead of vector of states.
      *	@param actual state
      *	@param control_input
      *	@return next state
      */
-    PoseVelocityState calcStates(const PoseVelocityState &states, const base::Vector6d &control_input);
+    PoseVelocityState calcStates(const PoseVelocityState &states, const base::Vector6d &control_input) const;
+
+    /** Performs one step simulation with a control input varying over the step
+     *
+     *  The stages are evaluated with the control input at their time: the
+     *  start, middle and end of the step for RUNGE_KUTTA_4, the start and end
+     *  for HEUN and the start for EULER.
+     *	@param actual state
+     *	@param start_input control input at the start of the step
+     *	@param middle_input control input at the middle of the step
+     *	@param end_input control input at the end of the step
+     *	@return next state
+     */
+    PoseVelocityState calcStates(const PoseVelocityState &states, const base::Vector6d &start_input,
+                                 const base::Vector6d &middle_input, const base::Vector6d &end_input) const;
+
+    /** Performs one step simulation, keeping the stages for dense output
+     *
+     *	@param actual state
+     *	@param control_input
+     *	@param dense_output filled with the step
+     *	@return next state
+     */
+    PoseVelocityState calcStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+                                 DenseOutputStep &dense_output) const;
+
+    /** Performs one step simulation in a water current
+     *
+     *  General form of the calcStates overloads above.
+     *	@param actual state
+     *	@param start_input control input at the start of the step
+     *	@param middle_input control input at the middle of the step
+     *	@param end_input control input at the end of the step
+     *	@param dense_output filled with the step if not NULL
+     *	@param current water current of the vehicle, NULL for still water
+     *	@return next state
+     */
+    PoseVelocityState calcStep(const PoseVelocityState &states, const base::Vector6d &start_input,
+                               const base::Vector6d &middle_input, const base::Vector6d &end_input,
+                               DenseOutputStep *dense_output, const CurrentEnvironment *current = NULL) const;
+
+    /** Performs a multi-rate step simulation
+     *
+     *  The velocities are integrated over n_steps integration steps with the
+     *  pose, and so the restoring efforts, held at its initial value. The pose
+     *  is then integrated in one step of n_steps integration steps, the stages
+     *  using the velocities linearly interpolated at their time. The kinematic
+     *  work is divided by n_steps, for a first order error in the orientation
+     *  used by the dynamics.
+     *	@param actual state
+     *	@param control_input
+     *	@param n_steps number of velocity steps per pose step, at least one
+     *	@param current water current of the vehicle, NULL for still water
+     *	@return state after n_steps integration steps
+     */
+    PoseVelocityState calcMultiRateStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+                                          unsigned int n_steps, const CurrentEnvironment *current = NULL) const;
+
+    /** Performs one step simulation with forward sensitivities
+     *
+     *  Integrates the sensitivity matrix S = d(state)/d(parameters) with the
+     *  same scheme and stages as the states:
+     *  dS/dt = d(deriv)/d(state) * S + d(deriv)/d(parameters)
+     *  The state vector is the one of toStateVector (Linearization.hpp) and the
+     *  parameters those of the derived class, see sensitivityDeriv.
+     *	@param actual state
+     *	@param control_input
+     *	@param sensitivity 13 x P matrix, updated to the next state
+     *	@return next state
+     */
+    PoseVelocityState calcStates(const PoseVelocityState &states, const base::Vector6d &control_input,
+                                 base::MatrixXd &sensitivity) const;
+
+    /** Compute derivative of the sensitivity matrix
+     *
+     *  @param current state
+     *  @param control input
+     *  @param sensitivity current 13 x P sensitivity matrix
+     *  @return 13 x P derivative
+     *
+     * This function is overloaded in the derived class. Throws if the class does not support sensitivities.
+     */
+    virtual base::MatrixXd sensitivityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                            const base::MatrixXd &sensitivity) const;
 
     /* Compute derivatives of states
      *
      * Particular case of state space representation. PoseVelocityState structure instead of vector of states.
      * @param current state
      * @param control input
+     * @param current water current of the vehicle, NULL for still water
      * @return state derivatives
      */
-    PoseVelocityState deriv(const PoseVelocityState &current_states, const base::Vector6d &control_input);
+    PoseVelocityState deriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                            const CurrentEnvironment *current = NULL) const;
 
     /** Compute derivative of velocity states
      *
      *  @param current state
      *  @param control input
+     *  @param context frame conversions of the current orientation
      *  @return velocity derivatives
      *
      * This function is overloaded in the derived class.
      */
-    virtual PoseVelocityState velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input) = 0;
+    virtual PoseVelocityState velocityDeriv(const PoseVelocityState &current_states, const base::Vector6d &control_input,
+                                            const EvaluationContext &context) const = 0;
 
     /** Compute derivative of pose states
      *
      *  @param current state
+     *  @param context frame conversions of the current orientation
      *  @return pose derivatives
      *
      * This function is overloaded in the derived class.
      */
-    virtual PoseVelocityState poseDeriv(const PoseVelocityState &current_states) = 0;
+    virtual PoseVelocityState poseDeriv(const PoseVelocityState &current_states, const EvaluationContext &context) const = 0;
 
 
     /** Set step
@@ -71,16 +205,47 @@ public:
      */
     void setIntegrationStep(double step);
 
+    /** Set integration scheme
+     *
+     *  RUNGE_KUTTA_4 by default.
+     *  @param scheme
+     */
+    void setIntegrationScheme(IntegrationScheme scheme);
+
+    /** Get integration scheme
+     *
+     *  @return scheme
+     */
+    IntegrationScheme getIntegrationScheme() const;
+
 private:
 
+    /**
+     * One step of each scheme, without normalization of the orientation.
+     * The stage derivatives are stored in stages if not NULL.
+     */
+    PoseVelocityState calcRK4Step(const PoseVelocityState &states, const base::Vector6d &start_input,
+                                  const base::Vector6d &middle_input, const base::Vector6d &end_input,
+                                  PoseVelocityState *stages, const CurrentEnvironment *current) const;
+    PoseVelocityState calcHeunStep(const PoseVelocityState &states, const base::Vector6d &start_input,
+                                   const base::Vector6d &end_input, PoseVelocityState *stages,
+                                   const CurrentEnvironment *current) const;
+    PoseVelocityState calcEulerStep(const PoseVelocityState &states, const base::Vector6d &control_input,
+                                    PoseVelocityState *stages, const CurrentEnvironment *current) const;
+
     /**
      * Integration step size
      */
     double integration_step;
 
+    /**
+     * Integration scheme
+     */
+    IntegrationScheme integration_scheme;
+
 
-    void checkStep(double step);
-    void checkInputs(const PoseVelocityState &states, const base::Vector6d &control_input);
+    void checkStep(double step) const;
+    void checkInputs(const PoseVelocityState &states, const base::Vector6d &control_input) const;
 };
 };
 
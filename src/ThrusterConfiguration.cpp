@@ -0,0 +1,173 @@
+#include "ThrusterConfiguration.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace uwv_dynamic_model
+{
+namespace
+{
+/**
+ * Piecewise linear interpolation of y(x), held outside of the table
+ */
+double interpolateTable(const std::vector<double> &x, const std::vector<double> &y, double value)
+{
+    if(x.empty())
+        return value;
+    if(value <= x.front())
+        return y.front();
+    if(value >= x.back())
+        return y.back();
+    size_t i = std::upper_bound(x.begin(), x.end(), value) - x.begin();
+    return y[i - 1] + (y[i] - y[i - 1]) * (value - x[i - 1]) / (x[i] - x[i - 1]);
+}
+
+bool isStrictlyIncreasing(const std::vector<double> &values)
+{
+    for(size_t i = 1; i < values.size(); i++)
+    {
+        if(!(values[i] > values[i - 1]))
+            return false;
+    }
+    return true;
+}
+}
+
+ThrusterConfiguration::ThrusterConfiguration(const std::vector<ThrusterDefinition> &thrusters)
+    : thrusters(thrusters)
+{
+    checkThrusters();
+
+    const size_t n = thrusters.size();
+    configuration_matrix.resize(6, n);
+    base::VectorXd inverse_sqrt_weights(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        ThrusterDefinition &thruster = this->thrusters[i];
+        thruster.direction.normalize();
+        configuration_matrix.col(i) << thruster.direction, thruster.position.cross(thruster.direction);
+        inverse_sqrt_weights[i] = 1 / std::sqrt(thruster.weight);
+    }
+
+    // min |W^(1/2)*f|^2 subject to T*f = tau, with f = W^(-1/2)*g: g = (T*W^(-1/2))^+ * tau
+    base::MatrixXd scaled = configuration_matrix * inverse_sqrt_weights.asDiagonal();
+    Eigen::JacobiSVD<base::MatrixXd> svd(scaled, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    base::VectorXd singular_values = svd.singularValues();
+    const double threshold = 1e-12 * std::max<double>(scaled.rows(), scaled.cols()) *
+            (singular_values.size() ? singular_values[0] : 0);
+    for(int i = 0; i < singular_values.size(); i++)
+        singular_values[i] = singular_values[i] > threshold ? 1 / singular_values[i] : 0;
+    allocation_matrix = inverse_sqrt_weights.asDiagonal() *
+            (svd.matrixV() * singular_values.asDiagonal() * svd.matrixU().transpose());
+}
+
+ThrusterConfiguration::~ThrusterConfiguration()
+{
+}
+
+void ThrusterConfiguration::checkThrusters() const
+{
+    if(thrusters.empty())
+        throw std::invalid_argument("ThrusterConfiguration: at least one thruster is required");
+    for(size_t i = 0; i < thrusters.size(); i++)
+    {
+        const ThrusterDefinition &thruster = thrusters[i];
+        if(!thruster.position.allFinite() || !thruster.direction.allFinite() || thruster.direction.isZero(0))
+            throw std::invalid_argument("ThrusterConfiguration: thruster position and direction must be finite, "
+                                        "with a non null direction");
+        if(thruster.command_table.size() != thruster.thrust_table.size() || thruster.command_table.size() == 1)
+            throw std::invalid_argument("ThrusterConfiguration: thrust curve needs as many commands as thrusts, "
+                                        "at least two");
+        if(!isStrictlyIncreasing(thruster.command_table) || !isStrictlyIncreasing(thruster.thrust_table))
+            throw std::invalid_argument("ThrusterConfiguration: thrust curve must be strictly increasing");
+        if(!(thruster.time_constant >= 0) || std::isinf(thruster.time_constant))
+            throw std::invalid_argument("ThrusterConfiguration: time constant must be positive or equal to zero");
+        if(!(thruster.weight > 0) || std::isinf(thruster.weight))
+            throw std::invalid_argument("ThrusterConfiguration: allocation weight must be positive");
+    }
+}
+
+size_t ThrusterConfiguration::getThrusterCount() const
+{
+    return thrusters.size();
+}
+
+const std::vector<ThrusterDefinition>& ThrusterConfiguration::getThrusters() const
+{
+    return thrusters;
+}
+
+const base::MatrixXd& ThrusterConfiguration::getConfigurationMatrix() const
+{
+    return configuration_matrix;
+}
+
+const base::MatrixXd& ThrusterConfiguration::getAllocationMatrix() const
+{
+    return allocation_matrix;
+}
+
+base::MatrixXd ThrusterConfiguration::calcEfforts(const base::MatrixXd &thrusts) const
+{
+    if(thrusts.rows() != configuration_matrix.cols())
+        throw std::invalid_argument("ThrusterConfiguration: one thrust per thruster is required");
+    return configuration_matrix * thrusts;
+}
+
+base::MatrixXd ThrusterConfiguration::allocateThrusts(const base::MatrixXd &efforts) const
+{
+    if(efforts.rows() != 6)
+        throw std::invalid_argument("ThrusterConfiguration: efforts must have 6 rows");
+    return allocation_matrix * efforts;
+}
+
+base::MatrixXd ThrusterConfiguration::calcThrusts(const base::MatrixXd &commands) const
+{
+    if(commands.rows() != configuration_matrix.cols())
+        throw std::invalid_argument("ThrusterConfiguration: one command per thruster is required");
+    base::MatrixXd thrusts(commands.rows(), commands.cols());
+    for(size_t i = 0; i < thrusters.size(); i++)
+    {
+        for(int j = 0; j < commands.cols(); j++)
+            thrusts(i, j) = interpolateTable(thrusters[i].command_table, thrusters[i].thrust_table, commands(i, j));
+    }
+    return thrusts;
+}
+
+base::MatrixXd ThrusterConfiguration::calcCommands(const base::MatrixXd &thrusts) const
+{
+    if(thrusts.rows() != configuration_matrix.cols())
+        throw std::invalid_argument("ThrusterConfiguration: one thrust per thruster is required");
+    base::MatrixXd commands(thrusts.rows(), thrusts.cols());
+    for(size_t i = 0; i < thrusters.size(); i++)
+    {
+        for(int j = 0; j < thrusts.cols(); j++)
+            commands(i, j) = interpolateTable(thrusters[i].thrust_table, thrusters[i].command_table, thrusts(i, j));
+    }
+    return commands;
+}
+
+base::VectorXd ThrusterConfiguration::calcThrustResponse(const base::VectorXd &thrusts,
+        const base::VectorXd &target_thrusts, double time) const
+{
+    if(thrusts.size() != configuration_matrix.cols() || target_thrusts.size() != configuration_matrix.cols())
+        throw std::invalid_argument("ThrusterConfiguration: one thrust per thruster is required");
+    base::VectorXd response = target_thrusts;
+    for(size_t i = 0; i < thrusters.size(); i++)
+    {
+        if(thrusters[i].time_constant > 0)
+            response[i] += (thrusts[i] - target_thrusts[i]) * std::exp(-time / thrusters[i].time_constant);
+    }
+    return response;
+}
+
+bool ThrusterConfiguration::isInstantaneous() const
+{
+    for(size_t i = 0; i < thrusters.size(); i++)
+    {
+        if(thrusters[i].time_constant > 0)
+            return false;
+    }
+    return true;
+}
+};
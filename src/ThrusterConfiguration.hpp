@@ -0,0 +1,151 @@
+#ifndef _THRUSTER_CONFIGURATION_H_
+#define _THRUSTER_CONFIGURATION_H_
+
+#include "DataTypes.hpp"
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/**
+ * Thruster of the vehicle
+ */
+struct ThrusterDefinition
+{
+    ThrusterDefinition() : position(base::Vector3d::Zero()), direction(base::Vector3d::UnitX()),
+                           time_constant(0), weight(1) {}
+
+    /**
+     * Position in body frame, relative to the origin of the body frame
+     */
+    base::Vector3d position;
+
+    /**
+     * Direction of positive thrust in body frame, normalized by the configuration
+     */
+    base::Vector3d direction;
+
+    /**
+     * Thrust curve: thrust at each command, linearly interpolated and held
+     * outside of the table. Both strictly increasing. Empty for a thrust
+     * equal to the command.
+     */
+    std::vector<double> command_table;
+    std::vector<double> thrust_table;
+
+    /**
+     * Time constant of the first-order response of the thrust to the command, 0 for an instantaneous response
+     */
+    double time_constant;
+
+    /**
+     * Cost of the thrust in the allocation, see ThrusterConfiguration::allocateThrusts
+     */
+    double weight;
+};
+
+/**********************************************************
+ * Thruster Configuration
+ * Mapping between thruster commands and efforts in body frame.
+ *
+ * The thrust configuration matrix (6 x n, column i = [d_i; p_i X d_i]) and
+ * its weighted pseudo-inverse are computed once at construction. The
+ * mappings take batches of samples, one column per sample.
+ **********************************************************/
+class ThrusterConfiguration
+{
+public:
+    /** Constructor
+     *
+     *  @param thrusters definitions, at least one
+     */
+    ThrusterConfiguration(const std::vector<ThrusterDefinition> &thrusters);
+
+    ~ThrusterConfiguration();
+
+    /** Get number of thrusters
+     *
+     *  @return n
+     */
+    size_t getThrusterCount() const;
+
+    /** Get thruster definitions
+     *
+     *  @return definitions, directions normalized
+     */
+    const std::vector<ThrusterDefinition>& getThrusters() const;
+
+    /** Get thrust configuration matrix
+     *
+     *  @return 6 x n matrix, efforts = matrix * thrusts
+     */
+    const base::MatrixXd& getConfigurationMatrix() const;
+
+    /** Get allocation matrix
+     *
+     *  Weighted pseudo-inverse of the configuration matrix, W^(-1/2) * (T * W^(-1/2))^+
+     *  with W the diagonal of the thruster weights.
+     *  @return n x 6 matrix, thrusts = matrix * efforts
+     */
+    const base::MatrixXd& getAllocationMatrix() const;
+
+    /** Compute efforts
+     *
+     *  @param thrusts n x N
+     *  @return 6 x N efforts in body frame
+     */
+    base::MatrixXd calcEfforts(const base::MatrixXd &thrusts) const;
+
+    /** Allocate efforts to the thrusters
+     *
+     *  Thrusts of least weighted squared norm producing the efforts, or the
+     *  closest efforts in the least squares sense if they are not reachable.
+     *  The saturation of the thrusters is not taken into account.
+     *  @param efforts 6 x N in body frame
+     *  @return n x N thrusts
+     */
+    base::MatrixXd allocateThrusts(const base::MatrixXd &efforts) const;
+
+    /** Compute steady-state thrusts of commands
+     *
+     *  @param commands n x N
+     *  @return n x N thrusts, see ThrusterDefinition::thrust_table
+     */
+    base::MatrixXd calcThrusts(const base::MatrixXd &commands) const;
+
+    /** Compute commands of steady-state thrusts
+     *
+     *  Inverse of calcThrusts, saturated to the thrust curves.
+     *  @param thrusts n x N
+     *  @return n x N commands
+     */
+    base::MatrixXd calcCommands(const base::MatrixXd &thrusts) const;
+
+    /** Compute the first-order response of the thrusts
+     *
+     *  Exact for constant target thrusts.
+     *  @param thrusts actual thrusts
+     *  @param target_thrusts steady-state thrusts of the commands
+     *  @param time since the commands were applied
+     *  @return thrusts after time
+     */
+    base::VectorXd calcThrustResponse(const base::VectorXd &thrusts, const base::VectorXd &target_thrusts,
+                                      double time) const;
+
+    /** Whether all the thrusters respond instantaneously
+     *
+     *  @return true if all the time constants are null
+     */
+    bool isInstantaneous() const;
+
+private:
+    /** Check thruster definitions
+     *
+     */
+    void checkThrusters() const;
+
+    std::vector<ThrusterDefinition> thrusters;
+    base::MatrixXd configuration_matrix;
+    base::MatrixXd allocation_matrix;
+};
+};
+#endif
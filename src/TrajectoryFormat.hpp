@@ -0,0 +1,77 @@
+#ifndef _TRAJECTORY_FORMAT_H_
+#define _TRAJECTORY_FORMAT_H_
+
+#include "DataTypes.hpp"
+#include <stdint.h>
+
+namespace uwv_dynamic_model
+{
+/**
+ * Binary trajectory file format
+ *
+ * The file starts with a fixed size TrajectoryFileHeader followed by blocks of
+ * samples. Each block holds block_size samples stored column-wise: all the
+ * values of one channel are contiguous inside a block, channel after channel.
+ *
+ *  | header | ch0[0..B-1] ch1[0..B-1] ... ch25[0..B-1] | ch0[B..2B-1] ... |
+ *
+ * The writer only ever appends blocks, the last block being padded up to
+ * block_size. The number of valid samples is kept in the header.
+ * Values are stored as native doubles, the endianness marker is used to
+ * reject files written in a different byte order.
+ */
+
+/**
+ * Offset of each channel inside a block.
+ * Orientation is stored following Eigen's coeffs() order (x, y, z, w).
+ */
+enum TrajectoryChannel
+{
+    TRAJECTORY_TIME = 0,
+    TRAJECTORY_POSITION = 1,
+    TRAJECTORY_ORIENTATION = 4,
+    TRAJECTORY_LINEAR_VELOCITY = 8,
+    TRAJECTORY_ANGULAR_VELOCITY = 11,
+    TRAJECTORY_LINEAR_ACCELERATION = 14,
+    TRAJECTORY_ANGULAR_ACCELERATION = 17,
+    TRAJECTORY_EFFORT = 20,
+    TRAJECTORY_CHANNEL_COUNT = 26
+};
+
+static const char TRAJECTORY_FILE_MAGIC[8] = {'U', 'W', 'V', 'T', 'R', 'A', 'J', '\0'};
+static const uint32_t TRAJECTORY_FILE_VERSION = 1;
+static const uint32_t TRAJECTORY_FILE_ENDIANNESS = 0x01020304;
+
+struct TrajectoryFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianness;
+    uint32_t channel_count;
+    uint32_t block_size;
+    uint64_t sample_count;
+    uint64_t reserved[4];
+};
+
+/**
+ * One sample of a trajectory
+ */
+struct TrajectorySample
+{
+    // Simulation time [s]
+    double time;
+    // Pose and velocities
+    PoseVelocityState state;
+    // Body-frame acceleration
+    AccelerationState acceleration;
+    // Efforts applied in body-frame
+    base::Vector6d effort;
+
+    TrajectorySample():
+        time(0),
+        effort(base::Vector6d::Zero())
+    {
+    }
+};
+};
+#endif
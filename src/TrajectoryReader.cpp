@@ -0,0 +1,141 @@
+#include "TrajectoryReader.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace uwv_dynamic_model
+{
+TrajectoryReader::TrajectoryReader(const std::string &path)
+    : mapping(NULL), mapping_size(0), header(NULL), data(NULL), sample_count(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("TrajectoryReader: could not open " + path);
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(TrajectoryFileHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("TrajectoryReader: " + path + " is not a trajectory file");
+    }
+
+    mapping_size = file_stat.st_size;
+    mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED)
+        throw std::runtime_error("TrajectoryReader: could not map " + path);
+
+    header = static_cast<const TrajectoryFileHeader*>(mapping);
+    data = reinterpret_cast<const double*>(static_cast<const char*>(mapping) + sizeof(TrajectoryFileHeader));
+
+    std::string error;
+    if(memcmp(header->magic, TRAJECTORY_FILE_MAGIC, sizeof(header->magic)) != 0)
+        error = "is not a trajectory file";
+    else if(header->endianness != TRAJECTORY_FILE_ENDIANNESS)
+        error = "was written with a different byte order";
+    else if(header->version != TRAJECTORY_FILE_VERSION)
+        error = "has an unsupported version";
+    else if(header->channel_count != TRAJECTORY_CHANNEL_COUNT || header->block_size == 0)
+        error = "has an invalid layout";
+    else
+    {
+        uint64_t blocks = (header->sample_count + header->block_size - 1) / header->block_size;
+        if(sizeof(TrajectoryFileHeader) + blocks * header->block_size * TRAJECTORY_CHANNEL_COUNT * sizeof(double) > mapping_size)
+            error = "is truncated";
+    }
+    if(!error.empty())
+    {
+        munmap(mapping, mapping_size);
+        throw std::runtime_error("TrajectoryReader: " + path + " " + error);
+    }
+
+    // A writer may still be appending, only the samples present now are exposed
+    sample_count = header->sample_count;
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+    munmap(mapping, mapping_size);
+}
+
+uint64_t TrajectoryReader::size() const
+{
+    return sample_count;
+}
+
+unsigned int TrajectoryReader::getBlockSize() const
+{
+    return header->block_size;
+}
+
+double TrajectoryReader::getTime(uint64_t index) const
+{
+    checkIndex(index);
+    return getValue(TRAJECTORY_TIME, index);
+}
+
+base::Vector6d TrajectoryReader::getEffort(uint64_t index) const
+{
+    checkIndex(index);
+    base::Vector6d effort;
+    for(size_t i = 0; i < 6; i++)
+        effort[i] = getValue(TRAJECTORY_EFFORT + i, index);
+    return effort;
+}
+
+TrajectorySample TrajectoryReader::getSample(uint64_t index) const
+{
+    checkIndex(index);
+    TrajectorySample sample;
+    sample.time = getValue(TRAJECTORY_TIME, index);
+    for(size_t i = 0; i < 3; i++)
+    {
+        sample.state.position[i] = getValue(TRAJECTORY_POSITION + i, index);
+        sample.state.linear_velocity[i] = getValue(TRAJECTORY_LINEAR_VELOCITY + i, index);
+        sample.state.angular_velocity[i] = getValue(TRAJECTORY_ANGULAR_VELOCITY + i, index);
+        sample.acceleration.linear_acceleration[i] = getValue(TRAJECTORY_LINEAR_ACCELERATION + i, index);
+        sample.acceleration.angular_acceleration[i] = getValue(TRAJECTORY_ANGULAR_ACCELERATION + i, index);
+    }
+    for(size_t i = 0; i < 4; i++)
+        sample.state.orientation.coeffs()[i] = getValue(TRAJECTORY_ORIENTATION + i, index);
+    for(size_t i = 0; i < 6; i++)
+        sample.effort[i] = getValue(TRAJECTORY_EFFORT + i, index);
+    return sample;
+}
+
+uint64_t TrajectoryReader::findIndex(double time) const
+{
+    if(size() == 0)
+        throw std::out_of_range("TrajectoryReader: trajectory is empty");
+
+    // First sample with time greater than the requested one
+    uint64_t first = 0;
+    uint64_t count = size();
+    while(count > 0)
+    {
+        uint64_t step = count / 2;
+        if(getValue(TRAJECTORY_TIME, first + step) <= time)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first == 0 ? 0 : first - 1;
+}
+
+TrajectorySample TrajectoryReader::getSampleAt(double time) const
+{
+    return getSample(findIndex(time));
+}
+
+void TrajectoryReader::checkIndex(uint64_t index) const
+{
+    if(index >= size())
+        throw std::out_of_range("TrajectoryReader: sample index out of range");
+}
+};
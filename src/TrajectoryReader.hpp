@@ -0,0 +1,112 @@
+#ifndef _TRAJECTORY_READER_H_
+#define _TRAJECTORY_READER_H_
+
+#include "TrajectoryFormat.hpp"
+#include <string>
+
+namespace uwv_dynamic_model
+{
+/**********************************************************
+ * Trajectory Reader
+ * Memory-mapped read access to binary trajectory files.
+ * See TrajectoryFormat.hpp for the file layout.
+ **********************************************************/
+class TrajectoryReader
+{
+public:
+    /** Map a trajectory file
+     *
+     *  Only the samples present when the file is opened are accessible.
+     *  @param path of the file
+     */
+    TrajectoryReader(const std::string &path);
+
+    ~TrajectoryReader();
+
+    /** Get number of samples
+     *
+     *  @return number of samples
+     */
+    uint64_t size() const;
+
+    /** Get number of samples per block
+     *
+     *  @return block size
+     */
+    unsigned int getBlockSize() const;
+
+    /** Get a single value of a channel
+     *
+     *  @param channel TrajectoryChannel offset plus the component index
+     *  @param index of the sample
+     *  @return value
+     */
+    inline double getValue(unsigned int channel, uint64_t index) const
+    {
+        const uint64_t n = header->block_size;
+        return data[(index / n) * n * TRAJECTORY_CHANNEL_COUNT + channel * n + index % n];
+    }
+
+    /** Get time of a sample
+     *
+     *  @param index of the sample
+     *  @return time
+     */
+    double getTime(uint64_t index) const;
+
+    /** Get effort of a sample
+     *
+     *  @param index of the sample
+     *  @return effort
+     */
+    base::Vector6d getEffort(uint64_t index) const;
+
+    /** Get sample
+     *
+     *  @param index of the sample
+     *  @return sample
+     */
+    TrajectorySample getSample(uint64_t index) const;
+
+    /** Find the sample at a given time
+     *
+     *  Binary search on the time channel.
+     *  @param time
+     *  @return index of the last sample with time lower or equal to time.
+     *  0 if time is before the first sample.
+     */
+    uint64_t findIndex(double time) const;
+
+    /** Get the sample at a given time
+     *
+     *  @param time
+     *  @return the last sample with time lower or equal to time
+     */
+    TrajectorySample getSampleAt(double time) const;
+
+private:
+    TrajectoryReader(const TrajectoryReader&);
+    TrajectoryReader& operator=(const TrajectoryReader&);
+
+    void checkIndex(uint64_t index) const;
+
+    /**
+     * Mapped file
+     */
+    void *mapping;
+    size_t mapping_size;
+
+    const TrajectoryFileHeader *header;
+
+    /**
+     * First value of the first block
+     */
+    const double *data;
+
+    /**
+     * Number of samples present when the file was mapped
+     */
+    uint64_t sample_count;
+};
+};
+#endif
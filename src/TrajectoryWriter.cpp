@@ -0,0 +1,126 @@
+#include "TrajectoryWriter.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <sys/types.h>
+
+namespace uwv_dynamic_model
+{
+TrajectoryWriter::TrajectoryWriter(const std::string &path, unsigned int block_size)
+    : file(NULL), block_fill(0), block_index(0),
+      last_time(-std::numeric_limits<double>::infinity())
+{
+    if(block_size == 0)
+        throw std::invalid_argument("TrajectoryWriter: block_size must be positive");
+
+    file = fopen(path.c_str(), "w+b");
+    if(!file)
+        throw std::runtime_error("TrajectoryWriter: could not open " + path);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAJECTORY_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_FILE_VERSION;
+    header.endianness = TRAJECTORY_FILE_ENDIANNESS;
+    header.channel_count = TRAJECTORY_CHANNEL_COUNT;
+    header.block_size = block_size;
+    header.sample_count = 0;
+
+    block.resize(TRAJECTORY_CHANNEL_COUNT * block_size, 0);
+    writeHeader();
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    try
+    {
+        close();
+    }
+    catch(const std::exception&)
+    {
+    }
+}
+
+void TrajectoryWriter::append(const TrajectorySample &sample)
+{
+    append(sample.time, sample.state, sample.acceleration, sample.effort);
+}
+
+void TrajectoryWriter::append(double time, const PoseVelocityState &state,
+                              const AccelerationState &acceleration, const base::Vector6d &effort)
+{
+    if(!file)
+        throw std::runtime_error("TrajectoryWriter: file is closed");
+    if(time < last_time)
+        throw std::invalid_argument("TrajectoryWriter: samples must be appended in non-decreasing time");
+    last_time = time;
+
+    const unsigned int n = header.block_size;
+    double *column = &block[block_fill];
+    column[TRAJECTORY_TIME*n] = time;
+    for(size_t i = 0; i < 3; i++)
+    {
+        column[(TRAJECTORY_POSITION + i)*n] = state.position[i];
+        column[(TRAJECTORY_LINEAR_VELOCITY + i)*n] = state.linear_velocity[i];
+        column[(TRAJECTORY_ANGULAR_VELOCITY + i)*n] = state.angular_velocity[i];
+        column[(TRAJECTORY_LINEAR_ACCELERATION + i)*n] = acceleration.linear_acceleration[i];
+        column[(TRAJECTORY_ANGULAR_ACCELERATION + i)*n] = acceleration.angular_acceleration[i];
+    }
+    for(size_t i = 0; i < 4; i++)
+        column[(TRAJECTORY_ORIENTATION + i)*n] = state.orientation.coeffs()[i];
+    for(size_t i = 0; i < 6; i++)
+        column[(TRAJECTORY_EFFORT + i)*n] = effort[i];
+
+    block_fill++;
+    header.sample_count++;
+
+    if(block_fill == n)
+    {
+        writeBlock();
+        block_index++;
+        block_fill = 0;
+        std::fill(block.begin(), block.end(), 0);
+    }
+}
+
+void TrajectoryWriter::flush()
+{
+    if(!file)
+        return;
+    if(block_fill > 0)
+        writeBlock();
+    writeHeader();
+    if(fflush(file) != 0)
+        throw std::runtime_error("TrajectoryWriter: could not flush file");
+}
+
+void TrajectoryWriter::close()
+{
+    if(!file)
+        return;
+    flush();
+    fclose(file);
+    file = NULL;
+}
+
+uint64_t TrajectoryWriter::size() const
+{
+    return header.sample_count;
+}
+
+void TrajectoryWriter::writeBlock()
+{
+    // fseeko as files grow beyond the range of long on 32 bits
+    const off_t block_bytes = block.size() * sizeof(double);
+    if(fseeko(file, sizeof(TrajectoryFileHeader) + block_index * block_bytes, SEEK_SET) != 0 ||
+            fwrite(&block[0], sizeof(double), block.size(), file) != block.size())
+        throw std::runtime_error("TrajectoryWriter: could not write block");
+}
+
+void TrajectoryWriter::writeHeader()
+{
+    if(fseeko(file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, file) != 1)
+        throw std::runtime_error("TrajectoryWriter: could not write header");
+}
+};
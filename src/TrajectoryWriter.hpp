@@ -0,0 +1,98 @@
+#ifndef _TRAJECTORY_WRITER_H_
+#define _TRAJECTORY_WRITER_H_
+
+#include "TrajectoryFormat.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace uwv_dynamic_model
+{
+/**********************************************************
+ * Trajectory Writer
+ * Append-only streaming writer of binary trajectory files.
+ * See TrajectoryFormat.hpp for the file layout.
+ **********************************************************/
+class TrajectoryWriter
+{
+public:
+    /** Create a new trajectory file. An existing file is truncated.
+     *
+     * @param path of the file
+     * @param block_size number of samples per block
+     */
+    TrajectoryWriter(const std::string &path, unsigned int block_size = 1024);
+
+    ~TrajectoryWriter();
+
+    /** Append one sample
+     *
+     *  Samples must be appended in non-decreasing time order.
+     *  @param sample
+     */
+    void append(const TrajectorySample &sample);
+
+    /** Append one sample
+     *
+     *  @param time
+     *  @param state pose and velocities
+     *  @param acceleration
+     *  @param effort applied efforts
+     */
+    void append(double time, const PoseVelocityState &state, const AccelerationState &acceleration,
+                const base::Vector6d &effort);
+
+    /** Write the pending samples and update the header.
+     *
+     *  After a flush the file can be opened by a TrajectoryReader.
+     */
+    void flush();
+
+    /** Flush and close the file.
+     *
+     */
+    void close();
+
+    /** Get number of samples appended so far
+     *
+     *  @return number of samples
+     */
+    uint64_t size() const;
+
+private:
+    TrajectoryWriter(const TrajectoryWriter&);
+    TrajectoryWriter& operator=(const TrajectoryWriter&);
+
+    /** Write the current block at its position in the file
+     *
+     */
+    void writeBlock();
+
+    /** Write the header at the beginning of the file
+     *
+     */
+    void writeHeader();
+
+    FILE *file;
+
+    TrajectoryFileHeader header;
+
+    /**
+     * Block being filled, stored channel-wise
+     */
+    std::vector<double> block;
+
+    /**
+     * Number of samples in the current block
+     */
+    unsigned int block_fill;
+
+    /**
+     * Index of the current block in the file
+     */
+    uint64_t block_index;
+
+    double last_time;
+};
+};
+#endif
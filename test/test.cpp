@@ -1,6 +1,10 @@
 #define BOOST_TEST_MODULE UWV_DYNAMIC_MODEL
 #include <boost/test/included/unit_test.hpp>
 #include <uwv_dynamic_model/ModelSimulation.hpp>
+#include <uwv_dynamic_model/TrajectoryWriter.hpp>
+#include <uwv_dynamic_model/TrajectoryReader.hpp>
+#include <uwv_dynamic_model/EffortReplay.hpp>
+#include <cstdio>
 #include <iostream>
 
 /**
@@ -201,6 +205,159 @@ BOOST_AUTO_TEST_SUITE_END()
 
 
 
+BOOST_AUTO_TEST_SUITE (TRAJECTORY_FILE)
+
+BOOST_AUTO_TEST_CASE( write_read )
+{
+    const std::string path = "uwv_trajectory_test.bin";
+    const size_t samples = 2500;
+
+    TrajectorySample sample;
+    {
+        TrajectoryWriter writer(path, 1000);
+        for(size_t i = 0; i < samples; i++)
+        {
+            sample.time = i*0.1;
+            sample.state.position = Vector3d::Constant(i);
+            sample.state.orientation = Eigen::AngleAxisd(i*0.001, Vector3d::UnitZ());
+            sample.state.linear_velocity = Vector3d::Constant(2.0*i);
+            sample.acceleration.angular_acceleration = Vector3d::Constant(-1.0*i);
+            sample.effort = Vector6d::Constant(3.0*i);
+            writer.append(sample);
+        }
+        BOOST_REQUIRE_EQUAL(writer.size(), samples);
+
+        // Going back in time
+        TrajectorySample previous = sample;
+        previous.time -= 1;
+        BOOST_REQUIRE_THROW(writer.append(previous), std::invalid_argument);
+    }
+
+    TrajectoryReader reader(path);
+    BOOST_REQUIRE_EQUAL(reader.size(), samples);
+
+    TrajectorySample last = reader.getSample(samples - 1);
+    BOOST_REQUIRE_EQUAL(last.time, sample.time);
+    BOOST_REQUIRE(last.state.position == sample.state.position);
+    BOOST_REQUIRE(last.state.orientation.coeffs() == sample.state.orientation.coeffs());
+    BOOST_REQUIRE(last.state.linear_velocity == sample.state.linear_velocity);
+    BOOST_REQUIRE(last.acceleration.angular_acceleration == sample.acceleration.angular_acceleration);
+    BOOST_REQUIRE(last.effort == sample.effort);
+
+    BOOST_REQUIRE_EQUAL(reader.findIndex(123.45), 1234);
+    BOOST_REQUIRE_EQUAL(reader.getSampleAt(100).state.position[0], 1000);
+    BOOST_REQUIRE_EQUAL(reader.findIndex(-1), 0);
+    BOOST_REQUIRE_EQUAL(reader.findIndex(1e6), samples - 1);
+    BOOST_REQUIRE_THROW(reader.getSample(samples), std::out_of_range);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( effort_replay )
+{
+    const std::string path = "uwv_effort_log.bin";
+    const std::string output_path = "uwv_effort_replay.bin";
+    UWVParameters parameters = loadParameters();
+
+    // Record the state before each effort is applied
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.1, 5);
+    vehicle.setUWVParameters(parameters);
+    {
+        TrajectoryWriter writer(path);
+        for(size_t i = 0; i < 300; i++)
+        {
+            Vector6d effort = Vector6d::Zero();
+            effort[0] = sin(i*0.05);
+            effort[5] = cos(i*0.02);
+            writer.append(vehicle.getCurrentTime(), vehicle.getPose(), vehicle.getAcceleration(), effort);
+            vehicle.sendEffort(effort);
+        }
+    }
+
+    EffortReplay replay(path, DYNAMIC_KINEMATIC, 0.1, 5);
+    BOOST_REQUIRE_EQUAL(replay.size(), 300);
+
+    // Same parameters reproduce the recorded run bit by bit
+    PoseVelocityState state = replay.replay(parameters, output_path);
+    BOOST_REQUIRE(state.position == vehicle.getPose().position);
+    BOOST_REQUIRE(state.orientation.coeffs() == vehicle.getPose().orientation.coeffs());
+    BOOST_REQUIRE(state.linear_velocity == vehicle.getPose().linear_velocity);
+    BOOST_REQUIRE(state.angular_velocity == vehicle.getPose().angular_velocity);
+
+    TrajectoryReader output(output_path);
+    BOOST_REQUIRE_EQUAL(output.size(), 300);
+    BOOST_REQUIRE(output.getSample(299).state.position == state.position);
+
+    // Parallel replays do not depend on the number of threads
+    std::vector<UWVParameters> parameter_sets(5, parameters);
+    for(size_t i = 0; i < parameter_sets.size(); i++)
+        parameter_sets[i].damping_matrices[0] *= (1 + 0.1*i);
+    std::vector<PoseVelocityState> serial = replay.replay(parameter_sets, std::vector<std::string>(), 1);
+    std::vector<PoseVelocityState> parallel = replay.replay(parameter_sets, std::vector<std::string>(), 3);
+    for(size_t i = 0; i < parameter_sets.size(); i++)
+    {
+        BOOST_REQUIRE(serial[i].position == parallel[i].position);
+        BOOST_REQUIRE(serial[i].linear_velocity == parallel[i].linear_velocity);
+    }
+    BOOST_REQUIRE(serial[0].position == state.position);
+    BOOST_REQUIRE(serial[4].position != state.position);
+
+    std::remove(path.c_str());
+    std::remove(output_path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( invalid_file )
+{
+    const std::string path = "uwv_trajectory_invalid.bin";
+    FILE *file = fopen(path.c_str(), "wb");
+    std::vector<char> garbage(256, 'x');
+    fwrite(&garbage[0], 1, garbage.size(), file);
+    fclose(file);
+
+    BOOST_REQUIRE_THROW(TrajectoryReader reader(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE (PROFILING)
+
+BOOST_AUTO_TEST_CASE( counters )
+{
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.1, 5);
+    vehicle.setUWVParameters(loadParameters());
+    Vector6d control_input = Vector6d::Ones();
+    for(size_t i = 0; i < 10; i++)
+        vehicle.sendEffort(control_input);
+
+    ProfileStats stats = vehicle.getProfileStats();
+    BOOST_REQUIRE_EQUAL(stats.model_type, SIMPLE);
+    if(isProfilingEnabled())
+    {
+        // 10 cycles * 5 steps * 4 stages, plus the acceleration at the end of each cycle
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_GRAVITY_BUOYANCY], 210);
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_SIMPLE_DAMPING], 210);
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_CORIOLIS], 0);
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_KINEMATICS], 400);
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_RK4_STAGES], 200);
+        BOOST_REQUIRE_EQUAL(stats.calls[PROFILE_INERTIA_INVERSION], 1);
+    }
+    else
+    {
+        for(size_t i = 0; i < PROFILE_TERM_COUNT; i++)
+            BOOST_REQUIRE_EQUAL(stats.calls[i], 0);
+    }
+
+    vehicle.resetProfileStats();
+    BOOST_REQUIRE_EQUAL(vehicle.getProfileStats().calls[PROFILE_GRAVITY_BUOYANCY], 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
 UWVParameters loadParameters(void)
 {
     UWVParameters parameters;
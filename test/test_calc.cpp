@@ -2,7 +2,18 @@
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 #include <uwv_dynamic_model/ModelSimulation.hpp>
+#include <uwv_dynamic_model/ParameterIdentification.hpp>
+#include <uwv_dynamic_model/BatchDynamics.hpp>
+#include <uwv_dynamic_model/BatchPropagation.hpp>
+#include <uwv_dynamic_model/MultipleShooting.hpp>
+#include <uwv_dynamic_model/Parareal.hpp>
+#include "AnalyticSolutions.hpp"
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
 
 /**
  * Commands for testing:
@@ -20,8 +31,6 @@ using namespace base;
 
 UWVParameters loadParameters(void);
 UWVParameters loadRotationalParameters(void);
-Vector3d calcOmega(base::Vector3d omega0, double t, double omegan);
-Orientation calcOrientation(base::Orientation init_ori, double t, double wn, double wi, base::Vector3d init_ang_mom);
 
 BOOST_AUTO_TEST_SUITE (CONSTRUCTOR)
 
@@ -221,6 +230,1315 @@ BOOST_AUTO_TEST_CASE( angular )
 
 }
 
+BOOST_AUTO_TEST_CASE(integration_schemes)
+{
+    double deltaT = 0.1;
+    double t = 60;
+    Vector3d omega0(0, 0, 0.10);
+    Orientation orientation = Eigen::AngleAxisd(omega0.norm() * t, omega0/omega0.norm()) * Orientation::Identity();
+
+    IntegrationScheme schemes[] = {EULER, HEUN, RUNGE_KUTTA_4};
+    double errors[3];
+    for(size_t k = 0; k < 3; k++)
+    {
+        ModelSimulation vehicle(DYNAMIC_KINEMATIC, deltaT, 1, 0);
+        vehicle.setUWVParameters(loadRotationalParameters());
+        vehicle.setIntegrationScheme(schemes[k]);
+        BOOST_REQUIRE_EQUAL(vehicle.getIntegrationScheme(), schemes[k]);
+
+        PoseVelocityState init_state;
+        init_state.angular_velocity = omega0;
+        vehicle.setPose(init_state);
+
+        for (int i = 0; i < t/deltaT; i++)
+            vehicle.sendEffort(Vector6d::Zero());
+        errors[k] = (vehicle.getPose().orientation * orientation.inverse()).vec().norm();
+    }
+
+    // Higher order schemes are more accurate for the same step
+    BOOST_CHECK_LT(errors[2], errors[1]);
+    BOOST_CHECK_LT(errors[1], errors[0]);
+    BOOST_CHECK_SMALL(errors[2], 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(evaluation_context)
+{
+    uwv_dynamic_model::DynamicModel model;
+    UWVParameters parameters = loadParameters();
+    parameters.weight = 3;
+    parameters.buoyancy = 1;
+    parameters.distance_body2centerofgravity = Vector3d(0.1, -0.2, 0.3);
+    model.setUWVParameters(parameters);
+
+    Orientation orientation(Eigen::AngleAxisd(0.7, Vector3d(1, -2, 0.5).normalized()));
+    EvaluationContext context(orientation);
+    BOOST_CHECK(context.toBody(context.toWorld(Vector3d(1, 2, 3))).isApprox(Vector3d(1, 2, 3)));
+    BOOST_CHECK(context.toWorld(Vector3d(1, 2, 3)).isApprox(orientation * Vector3d(1, 2, 3)));
+
+    // At rest the acceleration is the restoring effort expressed in body-frame
+    Vector3d world_z = orientation.inverse() * Vector3d::UnitZ();
+    Vector6d restoring;
+    restoring << world_z * 2, (parameters.distance_body2centerofgravity * 3).cross(world_z);
+    Vector6d acceleration = model.calcAcceleration(Vector6d::Zero(), Vector6d::Zero(), context);
+    BOOST_CHECK(acceleration.isApprox(-restoring));
+    BOOST_CHECK(acceleration.isApprox(model.calcAcceleration(Vector6d::Zero(), Vector6d::Zero(), orientation)));
+}
+
+BOOST_AUTO_TEST_CASE(acceleration_matches_state)
+{
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    UWVParameters parameters = loadParameters();
+    vehicle.setUWVParameters(parameters);
+    uwv_dynamic_model::DynamicModel model;
+    model.setUWVParameters(parameters);
+
+    Vector6d control_input(Vector6d::Zero());
+    control_input[0] = 2;
+    control_input[5] = 0.5;
+    for(int i = 0; i < 5; i++)
+        vehicle.sendEffort(control_input);
+
+    PoseVelocityState state = vehicle.getPose();
+    Vector6d velocity;
+    velocity << state.linear_velocity, state.angular_velocity;
+    Vector6d acceleration = model.calcAcceleration(control_input, velocity, state.orientation);
+    BOOST_CHECK(vehicle.getAcceleration().linear_acceleration.isApprox(acceleration.head<3>()));
+    BOOST_CHECK(vehicle.getAcceleration().angular_acceleration.isApprox(acceleration.tail<3>()));
+}
+
+BOOST_AUTO_TEST_CASE(shared_simulator)
+{
+    DynamicKinematicSimulator simulator(0.01);
+    simulator.getDynamicModel().setUWVParameters(loadParameters());
+
+    // Each thread integrates its own trajectory with the same simulator
+    const size_t n_threads = 4;
+    std::vector<PoseVelocityState> parallel(n_threads);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < n_threads; t++)
+    {
+        threads.push_back(std::thread([&, t]()
+        {
+            Vector6d control_input = Vector6d::Constant(t + 1.);
+            PoseVelocityState state;
+            for(int i = 0; i < 2000; i++)
+                state = simulator.calcStates(state, control_input);
+            parallel[t] = state;
+        }));
+    }
+    for(size_t t = 0; t < n_threads; t++)
+        threads[t].join();
+
+    for(size_t t = 0; t < n_threads; t++)
+    {
+        Vector6d control_input = Vector6d::Constant(t + 1.);
+        PoseVelocityState state;
+        for(int i = 0; i < 2000; i++)
+            state = simulator.calcStates(state, control_input);
+        BOOST_CHECK(state.position == parallel[t].position);
+        BOOST_CHECK(state.orientation.coeffs() == parallel[t].orientation.coeffs());
+        BOOST_CHECK(state.linear_velocity == parallel[t].linear_velocity);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(publish_parameters)
+{
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.01, 2, 0);
+    UWVParameters parameters = loadParameters();
+    vehicle.setUWVParameters(parameters);
+    Vector6d control_input = Vector6d::Ones();
+
+    // Applied at the start of the next cycle only
+    UWVParameters published = parameters;
+    published.damping_matrices[0] *= 2;
+    vehicle.publishUWVParameters(published);
+    BOOST_CHECK(vehicle.hasPendingUWVParameters());
+    BOOST_CHECK(vehicle.getUWVParameters().damping_matrices[0] == parameters.damping_matrices[0]);
+    vehicle.sendEffort(control_input);
+    BOOST_CHECK(!vehicle.hasPendingUWVParameters());
+    BOOST_CHECK(vehicle.getUWVParameters().damping_matrices[0] == published.damping_matrices[0]);
+
+    // Invalid parameters are rejected in the publishing thread
+    published.weight = -1;
+    BOOST_CHECK_THROW(vehicle.publishUWVParameters(published), std::invalid_argument);
+    BOOST_CHECK(!vehicle.hasPendingUWVParameters());
+
+    // Publishing while stepping
+    std::atomic<bool> running(true);
+    std::thread publisher([&]()
+    {
+        UWVParameters tuned = parameters;
+        for(int i = 0; running; i++)
+        {
+            tuned.damping_matrices[0] = parameters.damping_matrices[0] * (1 + (i % 10) * 0.1);
+            vehicle.publishUWVParameters(tuned);
+        }
+    });
+    for(int i = 0; i < 2000; i++)
+        vehicle.sendEffort(control_input);
+    running = false;
+    publisher.join();
+
+    vehicle.sendEffort(control_input);
+    BOOST_CHECK(!vehicle.getPose().hasNaN());
+    // Surge velocity bounded by the steady states of the extreme published sets
+    BOOST_CHECK_GT(vehicle.getPose().linear_velocity[0], 0.4);
+    BOOST_CHECK_LT(vehicle.getPose().linear_velocity[0], 0.65);
+}
+
+UWVParameters randomParameters(ModelType model_type)
+{
+    UWVParameters parameters;
+    parameters.model_type = model_type;
+    parameters.inertia_matrix = Matrix6d::Identity() * 50 + Matrix6d::Random();
+    parameters.damping_matrices.resize(model_type == COMPLEX ? 6 : 2);
+    for(size_t i = 0; i < parameters.damping_matrices.size(); i++)
+        parameters.damping_matrices[i] = Matrix6d::Identity() * 10 + Matrix6d::Random();
+    parameters.weight = 500;
+    parameters.buoyancy = 510;
+    parameters.distance_body2centerofgravity = Vector3d(0.01, -0.02, -0.1);
+    parameters.distance_body2centerofbuoyancy = Vector3d(0.02, 0.01, 0.05);
+    return parameters;
+}
+
+BOOST_AUTO_TEST_CASE(identification_regressor)
+{
+    const ModelType model_types[] = {SIMPLE, INTERMEDIATE, COMPLEX};
+    for(size_t m = 0; m < 3; m++)
+    {
+        UWVParameters parameters = randomParameters(model_types[m]);
+        uwv_dynamic_model::DynamicModel model;
+        model.setUWVParameters(parameters);
+        ParameterIdentification identification(model_types[m]);
+
+        Vector6d acceleration = Vector6d::Random();
+        Vector6d velocity = Vector6d::Random();
+        Orientation orientation(Eigen::AngleAxisd(0.4, Vector3d(0.3, -1, 0.2).normalized()));
+        Vector6d efforts = identification.calcRegressor(acceleration, velocity, orientation) *
+                identification.toParameterVector(parameters);
+        BOOST_CHECK(efforts.isApprox(model.calcEfforts(acceleration, velocity, orientation)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(identification_solve)
+{
+    UWVParameters parameters = randomParameters(INTERMEDIATE);
+    uwv_dynamic_model::DynamicModel model;
+    model.setUWVParameters(parameters);
+
+    const size_t n = 5000;
+    std::vector<Vector6d> accelerations(n), velocities(n), efforts(n);
+    std::vector<Orientation> orientations(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        accelerations[i] = Vector6d::Random();
+        velocities[i] = Vector6d::Random() * 2;
+        orientations[i] = Orientation(Eigen::AngleAxisd(i * 0.01, Vector3d(std::sin(i * 0.1), 1, 0.5).normalized()));
+        efforts[i] = model.calcEfforts(accelerations[i], velocities[i], orientations[i]);
+    }
+
+    // Batches in parallel and single samples give the same solution
+    ParameterIdentification batch(INTERMEDIATE);
+    batch.addSamples(accelerations, velocities, orientations, efforts, 4);
+    ParameterIdentification single(INTERMEDIATE);
+    for(size_t i = 0; i < n; i++)
+        single.addSample(accelerations[i], velocities[i], orientations[i], efforts[i]);
+    BOOST_CHECK_EQUAL(batch.getSampleCount(), n);
+    BOOST_CHECK(batch.solve().isApprox(single.solve(), 1e-8));
+
+    BOOST_CHECK(batch.solve().isApprox(batch.toParameterVector(parameters), 1e-8));
+    BOOST_CHECK_SMALL(batch.getResidualRMS(), 1e-8);
+
+    UWVParameters identified = batch.getUWVParameters(parameters.weight, parameters.distance_body2centerofgravity);
+    BOOST_CHECK(identified.inertia_matrix.isApprox(parameters.inertia_matrix, 1e-8));
+    BOOST_CHECK(identified.damping_matrices[1].isApprox(parameters.damping_matrices[1], 1e-8));
+    BOOST_CHECK_CLOSE(identified.buoyancy, parameters.buoyancy, 1e-6);
+    BOOST_CHECK(identified.distance_body2centerofbuoyancy.isApprox(parameters.distance_body2centerofbuoyancy, 1e-6));
+
+    // Diagonal structure ignores the off-diagonal entries
+    ParameterIdentification diagonal(SIMPLE, DIAGONAL_MATRICES);
+    BOOST_CHECK_EQUAL(diagonal.getParameterCount(), 22);
+    batch.reset();
+    BOOST_CHECK_EQUAL(batch.getSampleCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(batch_inverse_dynamics)
+{
+    const ModelType model_types[] = {SIMPLE, INTERMEDIATE, COMPLEX};
+    const size_t n = 3000;
+    for(size_t m = 0; m < 3; m++)
+    {
+        UWVParameters parameters = randomParameters(model_types[m]);
+        uwv_dynamic_model::DynamicModel model;
+        model.setUWVParameters(parameters);
+        BatchDynamics batch(parameters);
+
+        MatrixXd accelerations = MatrixXd::Random(n, 6);
+        MatrixXd velocities = MatrixXd::Random(n, 6);
+        MatrixXd orientations = MatrixXd::Random(n, 4);
+        MatrixXd efforts = batch.calcEfforts(accelerations, velocities, orientations, 4);
+        BOOST_CHECK(efforts == batch.calcEfforts(accelerations, velocities, orientations, 1));
+        for(size_t i = 0; i < n; i += 97)
+        {
+            Orientation orientation(Vector4d(orientations.row(i).transpose()));
+            Vector6d effort = model.calcEfforts(accelerations.row(i).transpose(), velocities.row(i).transpose(), orientation);
+            BOOST_CHECK(efforts.row(i).transpose().isApprox(effort));
+        }
+    }
+
+    BOOST_CHECK_THROW(BatchDynamics(loadParameters()).calcEfforts(MatrixXd::Zero(2, 6), MatrixXd::Zero(3, 6), MatrixXd::Zero(3, 4)),
+            std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(batch_finite_differences)
+{
+    // Exact for second order polynomials
+    const size_t n = 50;
+    const double dt = 0.1;
+    MatrixXd velocities(n, 6);
+    MatrixXd accelerations(n, 6);
+    for(size_t i = 0; i < n; i++)
+    {
+        double t = i * dt;
+        for(size_t j = 0; j < 6; j++)
+        {
+            velocities(i, j) = j + (j + 1) * t - 0.5 * j * t * t;
+            accelerations(i, j) = (j + 1) - j * t;
+        }
+    }
+    BOOST_CHECK(BatchDynamics::calcAccelerations(velocities, dt).isApprox(accelerations, 1e-10));
+    BOOST_CHECK_THROW(BatchDynamics::calcAccelerations(velocities.topRows(1), dt), std::invalid_argument);
+
+    MatrixXd orientations = MatrixXd::Zero(n, 4);
+    orientations.col(3).setOnes();
+    BatchDynamics batch(loadParameters());
+    BOOST_CHECK(batch.calcEfforts(velocities, orientations, dt).isApprox(
+            batch.calcEfforts(accelerations, velocities, orientations), 1e-10));
+}
+
+BOOST_AUTO_TEST_CASE(velocity_jacobian)
+{
+    const ModelType model_types[] = {SIMPLE, INTERMEDIATE, COMPLEX};
+    for(size_t m = 0; m < 3; m++)
+    {
+        uwv_dynamic_model::DynamicModel model;
+        model.setUWVParameters(randomParameters(model_types[m]));
+        Vector6d velocity;
+        velocity << 0.8, -0.3, 0.2, -0.1, 0.25, 0.4;
+        Matrix6d jacobian = model.calcVelocityJacobian(velocity);
+
+        // Central differences of the efforts
+        Matrix6d numeric;
+        const double h = 1e-6;
+        for(size_t j = 0; j < 6; j++)
+        {
+            Vector6d delta = Vector6d::Unit(j) * h;
+            numeric.col(j) = (model.calcSteadyStateEfforts(velocity + delta, Orientation::Identity()) -
+                    model.calcSteadyStateEfforts(velocity - delta, Orientation::Identity())) / (2 * h);
+        }
+        BOOST_CHECK(jacobian.isApprox(numeric, 1e-6));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(steady_state)
+{
+    uwv_dynamic_model::DynamicModel model;
+    model.setUWVParameters(loadParameters());
+
+    // Same steady state as the simulation of CONSTRUCTOR/normal
+    Vector6d control_input(Vector6d::Zero());
+    control_input[0] = 2;
+    Vector6d velocity = model.calcSteadyStateVelocity(control_input, Orientation::Identity());
+    BOOST_CHECK_CLOSE(velocity[0], 1, 1e-6);
+    BOOST_CHECK_SMALL(velocity.tail<5>().norm(), 1e-10);
+
+    // Inverse problem
+    UWVParameters parameters = randomParameters(COMPLEX);
+    model.setUWVParameters(parameters);
+    Orientation orientation(Eigen::AngleAxisd(0.3, Vector3d(1, 0.5, 0).normalized()));
+    Vector6d target;
+    target << 1.5, 0.2, -0.1, 0.05, -0.02, 0.1;
+    Vector6d efforts = model.calcSteadyStateEfforts(target, orientation);
+    BOOST_CHECK(model.calcAcceleration(efforts, target, orientation).isZero(1e-10));
+    BOOST_CHECK(model.calcSteadyStateVelocity(efforts, orientation).isApprox(target, 1e-8));
+}
+
+BOOST_AUTO_TEST_CASE(trim)
+{
+    uwv_dynamic_model::DynamicModel model;
+    UWVParameters parameters = randomParameters(INTERMEDIATE);
+    // Restoring torque: center of gravity below the center of buoyancy
+    parameters.weight = 500;
+    parameters.buoyancy = 500;
+    parameters.distance_body2centerofgravity = Vector3d(0, 0, -0.1);
+    parameters.distance_body2centerofbuoyancy = Vector3d::Zero();
+    model.setUWVParameters(parameters);
+
+    // Surge force and yaw torque: steady turn
+    Vector6d efforts;
+    efforts << 40, 0, 0, 0, 0, 5;
+    PoseVelocityState trim = model.calcTrim(efforts);
+    Vector6d velocity;
+    velocity << trim.linear_velocity, trim.angular_velocity;
+    BOOST_CHECK(model.calcAcceleration(efforts, velocity, trim.orientation).isZero(1e-9));
+    BOOST_CHECK_GT(trim.linear_velocity[0], 0);
+    // Constant attitude: rotation around the world z axis only
+    BOOST_CHECK_SMALL((trim.orientation * trim.angular_velocity).head<2>().norm(), 1e-10);
+
+    // The simulation stays in the trim state
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.01, 2, 0);
+    vehicle.setUWVParameters(parameters);
+    vehicle.setPose(trim);
+    for(int i = 0; i < 100; i++)
+        vehicle.sendEffort(efforts);
+    BOOST_CHECK(vehicle.getPose().linear_velocity.isApprox(trim.linear_velocity, 1e-6));
+    BOOST_CHECK(vehicle.getPose().angular_velocity.isApprox(trim.angular_velocity, 1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(matrix_exponential)
+{
+    // exp([0 w; -w 0]*t) is a rotation of angle w*t
+    MatrixXd matrix(2, 2);
+    matrix << 0, 3, -3, 0;
+    MatrixXd rotation(2, 2);
+    rotation << std::cos(3.), std::sin(3.), -std::sin(3.), std::cos(3.);
+    BOOST_CHECK(calcMatrixExponential(matrix).isApprox(rotation, 1e-12));
+    BOOST_CHECK(calcMatrixExponential(MatrixXd::Zero(4, 4)).isIdentity());
+}
+
+BOOST_AUTO_TEST_CASE(linearization)
+{
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    UWVParameters parameters = randomParameters(INTERMEDIATE);
+    vehicle.setUWVParameters(parameters);
+
+    PoseVelocityState state;
+    state.linear_velocity = Vector3d(1, 0.1, 0);
+    state.angular_velocity = Vector3d(0, 0, 0.2);
+    state.orientation = Orientation(Eigen::AngleAxisd(0.5, Vector3d::UnitZ()));
+    Vector6d control_input;
+    control_input << 30, 0, 0, 0, 0, 2;
+
+    LinearModel integrator = vehicle.linearize(state, control_input, INTEGRATOR);
+    LinearModel exponential = vehicle.linearize(state, control_input, MATRIX_EXPONENTIAL);
+    BOOST_CHECK_EQUAL(integrator.A.rows(), 13);
+    BOOST_CHECK_EQUAL(integrator.B.cols(), 6);
+    // Same velocity dynamics up to the variation of the Jacobian along the cycle
+    BOOST_CHECK(exponential.A.bottomRows(6).isApprox(integrator.A.bottomRows(6), 1e-2));
+    BOOST_CHECK(exponential.B.isApprox(integrator.B, 1e-2));
+
+    // Prediction of a perturbed cycle
+    PoseVelocityState perturbed = state;
+    perturbed.linear_velocity[0] += 1e-3;
+    perturbed.angular_velocity[2] += 1e-3;
+    Vector6d perturbed_input = control_input;
+    perturbed_input[1] += 1e-2;
+    VectorXd next = toStateVector(vehicle.sendEffort(control_input, state));
+    BOOST_CHECK((toStateVector(state) + integrator.c).isApprox(next, 1e-12));
+    // Same motion from the operating point up to the discretization
+    BOOST_CHECK_SMALL((exponential.c - integrator.c).norm(), 1e-2);
+    VectorXd predicted = next +
+            integrator.A * (toStateVector(perturbed) - toStateVector(state)) + integrator.B * (perturbed_input - control_input);
+    VectorXd simulated = toStateVector(vehicle.sendEffort(perturbed_input, perturbed));
+    BOOST_CHECK_SMALL((predicted - simulated).norm(), 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(linearization_table)
+{
+    ModelSimulation vehicle(DYNAMIC_KINEMATIC, 0.1, 5, 0);
+    vehicle.setUWVParameters(randomParameters(SIMPLE));
+
+    std::vector<double> speeds = {0, 0.5, 1, 1.5};
+    std::vector<double> yaw_rates = {-0.2, 0, 0.2};
+    LinearizationTable table(speeds, yaw_rates);
+    BOOST_CHECK(!table.isBuilt());
+    BOOST_CHECK_THROW(table.lookup(1, 0), std::runtime_error);
+    table.build(vehicle, INTEGRATOR, 4);
+
+    // Nodes are steady motions: constant velocities, moving pose given by the affine term
+    const LinearModel &node = table.getNode(2, 2);
+    PoseVelocityState next = vehicle.sendEffort(node.control_input, node.state);
+    BOOST_CHECK(next.linear_velocity.isApprox(node.state.linear_velocity, 1e-6));
+    BOOST_CHECK(next.angular_velocity.isApprox(node.state.angular_velocity, 1e-6));
+    BOOST_CHECK((toStateVector(node.state) + node.c).isApprox(toStateVector(next), 1e-12));
+    BOOST_CHECK_GT(node.c.head<3>().norm(), 0.05);
+
+    BOOST_CHECK(table.lookup(1, 0.2).A == node.A);
+    LinearModel middle = table.lookup(0.75, 0.1);
+    MatrixXd average = (table.getNode(1, 1).A + table.getNode(2, 1).A + table.getNode(1, 2).A + table.getNode(2, 2).A) / 4;
+    BOOST_CHECK(middle.A.isApprox(average));
+    VectorXd average_c = (table.getNode(1, 1).c + table.getNode(2, 1).c + table.getNode(1, 2).c + table.getNode(2, 2).c) / 4;
+    BOOST_CHECK(middle.c.isApprox(average_c));
+    BOOST_CHECK_CLOSE(middle.state.linear_velocity[0], 0.75, 1e-9);
+    // Clamped outside of the grid
+    BOOST_CHECK(table.lookup(5, -1).B == table.getNode(3, 0).B);
+}
+
+BOOST_AUTO_TEST_CASE(exact_discretization)
+{
+    UWVParameters parameters = loadParameters();
+    parameters.damping_matrices[1] = Matrix6d::Zero();
+    parameters.weight = 1;
+    parameters.buoyancy = 1.5;
+    ModelSimulation exact(DYNAMIC, 0.1, 10, 0);
+    exact.setUWVParameters(parameters);
+    ModelSimulation integrated(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    integrated.setUWVParameters(parameters);
+
+    Vector6d control_input(Vector6d::Zero());
+    control_input[0] = 2;
+    control_input[5] = 0.5;
+    for(int i = 0; i < 30; i++)
+    {
+        exact.sendEffort(control_input);
+        integrated.sendEffort(control_input);
+    }
+
+    // m*dv/dt + d*v = u - (W-B): v(t) = (u - (W-B))/d * (1 - exp(-d*t/m))
+    double t = 3;
+    BOOST_CHECK_CLOSE(exact.getPose().linear_velocity[0], 2 * (1 - std::exp(-t)), 1e-10);
+    BOOST_CHECK_CLOSE(exact.getPose().linear_velocity[2], 0.5 * (1 - std::exp(-t)), 1e-10);
+    BOOST_CHECK_CLOSE(exact.getPose().angular_velocity[2], 0.5 * (1 - std::exp(-t)), 1e-10);
+    BOOST_CHECK_CLOSE(exact.getAcceleration().linear_acceleration[0], 2 * std::exp(-t), 1e-9);
+    // Same velocities as the integration, in the world z direction
+    BOOST_CHECK_CLOSE(integrated.getPose().linear_velocity[0], exact.getPose().linear_velocity[0], 1e-6);
+    BOOST_CHECK(exact.getPose().position.isZero());
+    // NaNs are rejected before the exact discretization
+    PoseVelocityState invalid_state = exact.getPose();
+    invalid_state.linear_velocity[1] = std::numeric_limits<double>::quiet_NaN();
+    BOOST_CHECK_THROW(exact.simulateCycle(invalid_state, control_input), std::runtime_error);
+    BOOST_CHECK_THROW(exact.simulateCycle(exact.getPose(), Vector6d::Constant(std::numeric_limits<double>::quiet_NaN())),
+                      std::runtime_error);
+
+    // Published sets are discretized by the publishing thread, or again if the sampling time changed since
+    parameters.damping_matrices[0] *= 2;
+    ModelSimulation reference(DYNAMIC, 0.05, 10, 0);
+    reference.setUWVParameters(parameters);
+    for(int i = 0; i < 2; i++)
+    {
+        ModelSimulation published(DYNAMIC, i ? 0.1 : 0.05, 10, 0);
+        published.setUWVParameters(loadParameters());
+        published.publishUWVParameters(parameters);
+        published.setSamplingTime(0.05);
+        BOOST_CHECK(toStateVector(published.sendEffort(control_input, PoseVelocityState())) ==
+                toStateVector(reference.sendEffort(control_input, PoseVelocityState())));
+    }
+}
+
+/**
+ * Parameter j of the sensitivity analysis (see DynamicModel::getSensitivityParameterCount)
+ */
+double& sensitivityParameter(UWVParameters &parameters, size_t j)
+{
+    size_t offset = 6 * parameters.damping_matrices.size();
+    if(j < offset)
+        return parameters.damping_matrices[j / 6](j % 6, j % 6);
+    if(j == offset)
+        return parameters.weight;
+    if(j == offset + 1)
+        return parameters.buoyancy;
+    if(j < offset + 5)
+        return parameters.distance_body2centerofgravity[j - offset - 2];
+    return parameters.distance_body2centerofbuoyancy[j - offset - 5];
+}
+
+BOOST_AUTO_TEST_CASE(forward_sensitivity)
+{
+    const ModelType model_types[] = {INTERMEDIATE, COMPLEX};
+    for(size_t m = 0; m < 2; m++)
+    {
+        UWVParameters parameters = randomParameters(model_types[m]);
+        DynamicKinematicSimulator simulator(0.05);
+        simulator.getDynamicModel().setUWVParameters(parameters);
+        const size_t n_parameters = simulator.getDynamicModel().getSensitivityParameterCount();
+
+        PoseVelocityState init_state;
+        init_state.linear_velocity = Vector3d(1, 0.2, -0.1);
+        init_state.angular_velocity = Vector3d(0.1, -0.05, 0.3);
+        init_state.orientation = Orientation(Eigen::AngleAxisd(0.4, Vector3d(1, 1, 0).normalized()));
+        Vector6d control_input;
+        control_input << 20, 5, -3, 1, -2, 4;
+
+        // Same trajectory as without sensitivities
+        PoseVelocityState state = init_state;
+        PoseVelocityState reference = init_state;
+        MatrixXd sensitivity = MatrixXd::Zero(13, n_parameters);
+        for(int i = 0; i < 40; i++)
+        {
+            state = simulator.calcStates(state, control_input, sensitivity);
+            reference = simulator.calcStates(reference, control_input);
+        }
+        BOOST_CHECK(toStateVector(state).isApprox(toStateVector(reference), 1e-12));
+
+        // Central differences of re-simulated trajectories
+        for(size_t j = 0; j < n_parameters; j++)
+        {
+            VectorXd final_states[2];
+            double h = 1e-6 * std::max(1., std::abs(sensitivityParameter(parameters, j)));
+            for(size_t side = 0; side < 2; side++)
+            {
+                UWVParameters perturbed = parameters;
+                sensitivityParameter(perturbed, j) += side ? h : -h;
+                DynamicKinematicSimulator perturbed_simulator(0.05);
+                perturbed_simulator.getDynamicModel().setUWVParameters(perturbed);
+                PoseVelocityState perturbed_state = init_state;
+                for(int i = 0; i < 40; i++)
+                    perturbed_state = perturbed_simulator.calcStates(perturbed_state, control_input);
+                final_states[side] = toStateVector(perturbed_state);
+            }
+            VectorXd numeric = (final_states[1] - final_states[0]) / (2 * h);
+            BOOST_CHECK_SMALL((sensitivity.col(j) - numeric).norm(), 1e-6 * (1 + numeric.norm()));
+        }
+    }
+
+    // One row per state
+    DynamicSimulator simulator(0.05);
+    MatrixXd sensitivity = MatrixXd::Zero(12, 20);
+    BOOST_CHECK_THROW(simulator.calcStates(PoseVelocityState(), Vector6d::Zero(), sensitivity), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(batch_propagation)
+{
+    const ModelSimulator simulators[] = {DYNAMIC, DYNAMIC_KINEMATIC};
+    const size_t n = 600;
+    UWVParameters parameters = randomParameters(COMPLEX);
+    Vector6d control_input;
+    control_input << 20, 5, -3, 1, -2, 4;
+
+    MatrixXd states(13, n);
+    states.topRows(3) = MatrixXd::Random(3, n);
+    states.middleRows(3, 4) = MatrixXd::Random(4, n);
+    states.bottomRows(6) = MatrixXd::Random(6, n);
+    for(size_t i = 0; i < n; i++)
+        states.block<4, 1>(3, i).normalize();
+
+    for(size_t s = 0; s < 2; s++)
+    {
+        ModelSimulation simulation(simulators[s], 0.05, 5);
+        simulation.setUWVParameters(parameters);
+        BatchPropagation batch(parameters, simulators[s], 0.05, 5);
+        MatrixXd propagated = batch.propagate(states, control_input, 4);
+        BOOST_CHECK(propagated == batch.propagate(states, control_input, 1));
+        for(size_t i = 0; i < n; i += 37)
+        {
+            VectorXd expected = toStateVector(simulation.sendEffort(control_input, fromStateVector(states.col(i))));
+            BOOST_CHECK(propagated.col(i).isApprox(expected, 1e-10));
+        }
+
+        // Accelerations, one sample per row
+        uwv_dynamic_model::DynamicModel model;
+        model.setUWVParameters(parameters);
+        BatchDynamics dynamics(parameters);
+        MatrixXd accelerations = dynamics.calcAcceleration(control_input, states.bottomRows(6).transpose(),
+                states.middleRows(3, 4).transpose());
+        for(size_t i = 0; i < n; i += 37)
+        {
+            Orientation orientation(Vector4d(states.block<4, 1>(3, i)));
+            BOOST_CHECK(accelerations.row(i).transpose().isApprox(
+                    model.calcAcceleration(control_input, states.block<6, 1>(7, i), orientation), 1e-10));
+        }
+    }
+
+    BatchPropagation batch(parameters);
+    BOOST_CHECK_THROW(batch.propagate(MatrixXd::Zero(12, 3), control_input), std::invalid_argument);
+    MatrixXd invalid = states;
+    invalid(8, 5) = std::numeric_limits<double>::quiet_NaN();
+    BOOST_CHECK_THROW(batch.propagate(invalid, control_input), std::runtime_error);
+
+    // Statistics with different mean and covariance weights, as for sigma points
+    VectorXd mean_weights = VectorXd::Constant(n, 1.0 / n);
+    VectorXd covariance_weights = mean_weights;
+    mean_weights[0] = 0.5 / n;
+    covariance_weights[0] = 2.5 / n;
+    BatchStatistics statistics;
+    MatrixXd propagated = batch.propagate(states, control_input, mean_weights, covariance_weights, statistics);
+    BatchStatistics expected = BatchPropagation::calcStatistics(propagated, mean_weights, covariance_weights);
+    BOOST_CHECK(statistics.mean.isApprox(expected.mean, 1e-12));
+    BOOST_CHECK(statistics.covariance.isApprox(expected.covariance, 1e-12));
+    BOOST_CHECK(!statistics.covariance.isApprox(BatchPropagation::calcStatistics(propagated, mean_weights).covariance, 1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(batch_statistics)
+{
+    // Two states symmetric about the mean, the second quaternion with the opposite sign
+    const double angle = 0.2;
+    Orientation mean_orientation(Eigen::AngleAxisd(0.5, Vector3d::UnitZ()));
+    MatrixXd states(13, 2);
+    for(size_t i = 0; i < 2; i++)
+    {
+        double sign = i ? -1 : 1;
+        Orientation orientation = mean_orientation * Orientation(Eigen::AngleAxisd(sign * angle, Vector3d::UnitX()));
+        states.col(i) << sign * Vector3d(1, 0, 0), sign * orientation.coeffs(), Vector6d::Constant(sign * 2);
+    }
+    BatchStatistics statistics = BatchPropagation::calcStatistics(states);
+    BOOST_CHECK(statistics.mean.head<3>().isZero(1e-12));
+    BOOST_CHECK(statistics.mean.tail<6>().isZero(1e-12));
+    Orientation orientation;
+    orientation.coeffs() = statistics.mean.segment<4>(3);
+    BOOST_CHECK(orientation.isApprox(mean_orientation, 1e-12));
+
+    // Opposite errors
+    VectorXd error(12);
+    error << 1, 0, 0, angle, 0, 0, Vector6d::Constant(2);
+    MatrixXd expected = error * error.transpose();
+    BOOST_CHECK(statistics.covariance.isApprox(expected, 1e-12));
+
+    // Weighted
+    statistics = BatchPropagation::calcStatistics(states, Eigen::Vector2d(0.75, 0.25), Eigen::Vector2d(1, 1));
+    BOOST_CHECK(statistics.mean.head<3>().isApprox(Vector3d(0.5, 0, 0), 1e-12));
+    BOOST_CHECK_THROW(BatchPropagation::calcStatistics(states, Vector3d::Ones()), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(multiple_shooting)
+{
+    ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    simulation.setUWVParameters(randomParameters(COMPLEX));
+    PoseVelocityState state;
+    state.linear_velocity = Vector3d(1, 0.2, -0.1);
+    state.angular_velocity = Vector3d(0.1, -0.05, 0.3);
+    simulation.setPose(state);
+
+    // Nodes of a simulated trajectory are continuous
+    const size_t n = 20;
+    std::vector<PoseVelocityState> nodes(1, state);
+    std::vector<Vector6d> controls;
+    for(size_t i = 0; i < n; i++)
+    {
+        controls.push_back(Vector6d::Random() * 10);
+        nodes.push_back(simulation.sendEffort(controls.back()));
+    }
+    MultipleShooting shooting(simulation);
+    ShootingEvaluation evaluation = shooting.evaluate(nodes, controls, false, 4);
+    BOOST_CHECK(evaluation.defects.isZero(1e-12));
+    BOOST_CHECK(evaluation.jacobians.empty());
+
+    // Moved node: defect of the previous segment and end state of the next one
+    nodes[5].position += Vector3d(0.5, 0, 0);
+    evaluation = shooting.evaluate(nodes, controls, true, 4);
+    ShootingEvaluation serial = shooting.evaluate(nodes, controls, true, 1);
+    BOOST_CHECK(evaluation.defects == serial.defects);
+    VectorXd defect = VectorXd::Zero(13);
+    defect[0] = 0.5;
+    BOOST_CHECK((evaluation.defects.col(4) - defect).isZero(1e-12));
+    BOOST_CHECK(evaluation.end_states[5].position.isApprox(nodes[6].position + Vector3d(0.5, 0, 0), 1e-12));
+    BOOST_CHECK_EQUAL(evaluation.jacobians.size(), n);
+    BOOST_CHECK(evaluation.jacobians[7].A == simulation.linearize(nodes[7], controls[7], INTEGRATOR).A);
+    BOOST_CHECK(evaluation.jacobians[7].B == serial.jacobians[7].B);
+
+    std::vector<PoseVelocityState> end_states = shooting.simulateSegments(
+            std::vector<PoseVelocityState>(nodes.begin(), nodes.end() - 1), controls);
+    BOOST_CHECK(toStateVector(end_states[5]) == toStateVector(evaluation.end_states[5]));
+    BOOST_CHECK_THROW(shooting.evaluate(nodes, std::vector<Vector6d>(n + 1)), std::invalid_argument);
+
+    // Opposite quaternion of a node, same orientation
+    nodes[10].orientation.coeffs() *= -1;
+    evaluation = shooting.evaluate(nodes, controls, true, 4);
+    BOOST_CHECK(evaluation.defects.col(9).isZero(1e-12));
+    BOOST_CHECK(evaluation.end_states[9].orientation.coeffs().isApprox(nodes[10].orientation.coeffs(), 1e-12));
+    LinearModel flipped = evaluation.jacobians[9];
+    LinearModel direct = simulation.linearize(nodes[9], controls[9], INTEGRATOR);
+    BOOST_CHECK(flipped.A.middleRows(3, 4) == -direct.A.middleRows(3, 4));
+    BOOST_CHECK((toStateVector(nodes[9]) + flipped.c).isApprox(toStateVector(nodes[10]), 1e-12));
+}
+
+BOOST_AUTO_TEST_CASE(parareal)
+{
+    ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    simulation.setUWVParameters(randomParameters(INTERMEDIATE));
+    PoseVelocityState initial_state;
+    initial_state.linear_velocity = Vector3d(1, 0.2, -0.1);
+    simulation.setPose(initial_state);
+
+    const size_t n = 400;
+    std::vector<Vector6d> controls;
+    std::vector<PoseVelocityState> serial;
+    for(size_t i = 0; i < n; i++)
+    {
+        controls.push_back(Vector6d::Constant(5 * std::sin(0.01 * i)));
+        serial.push_back(simulation.sendEffort(controls.back()));
+    }
+
+    // Converged before one iteration per slice
+    Parareal parareal(simulation);
+    parareal.setTolerance(1e-10);
+    std::vector<PoseVelocityState> parallel = parareal.simulate(initial_state, controls, 4, 8);
+    BOOST_CHECK(parareal.getIterations() < 8);
+    for(size_t i = 0; i < n; i++)
+        BOOST_CHECK(toStateVector(parallel[i]).isApprox(toStateVector(serial[i]), 1e-8));
+
+    // Exact with one iteration per slice, even with a poor coarse propagator
+    Parareal exact(simulation, EULER);
+    exact.setTolerance(0);
+    parallel = exact.simulate(initial_state, controls, 4, 8);
+    BOOST_CHECK(exact.getIterations() <= 8);
+    BOOST_CHECK(toStateVector(parallel.back()) == toStateVector(serial.back()));
+
+    exact.setMaxIterations(1);
+    exact.simulate(initial_state, controls, 4, 8);
+    BOOST_CHECK_EQUAL(exact.getIterations(), 1);
+    BOOST_CHECK(exact.simulate(initial_state, std::vector<Vector6d>()).empty());
+
+    // The coarse propagator integrates linear models that the fine one discretizes exactly
+    UWVParameters linear_parameters = loadParameters();
+    linear_parameters.model_type = SIMPLE;
+    linear_parameters.damping_matrices[1].setZero();
+    ModelSimulation linear(DYNAMIC, 0.1, 10, 0);
+    linear.setUWVParameters(linear_parameters);
+    Parareal linear_parareal(linear, EULER);
+    linear_parareal.setTolerance(1e-12);
+    std::vector<PoseVelocityState> linear_parallel = linear_parareal.simulate(initial_state, controls, 4, 8);
+    BOOST_CHECK_GT(linear_parareal.getIterations(), 1);
+    PoseVelocityState linear_state = initial_state;
+    for(size_t i = 0; i < n; i++)
+        linear_state = linear.sendEffort(controls[i], linear_state);
+    BOOST_CHECK(toStateVector(linear_parallel.back()).isApprox(toStateVector(linear_state), 1e-10));
+
+    simulation.setInputDelay(0.1);
+    BOOST_CHECK_THROW(parareal.simulate(initial_state, controls, 4, 8), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(effort_profile)
+{
+    UWVParameters parameters = loadParameters();
+    Vector6d effort;
+    effort << 20, 5, -3, 1, -2, 4;
+
+    // Constant profile, same cycle as sendEffort
+    ModelSimulation constant(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    constant.setUWVParameters(parameters);
+    ModelSimulation profiled(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    profiled.setUWVParameters(parameters);
+    std::vector<double> times;
+    for(int i = 0; i < 5; i++)
+    {
+        constant.sendEffort(effort);
+        profiled.sendEffortProfile([&](double time) { times.push_back(time); return effort; });
+    }
+    BOOST_CHECK(toStateVector(constant.getPose()) == toStateVector(profiled.getPose()));
+    BOOST_CHECK(constant.getAcceleration().linear_acceleration == profiled.getAcceleration().linear_acceleration);
+    BOOST_CHECK_CLOSE(profiled.getCurrentTime(), 0.5, 1e-10);
+    BOOST_CHECK_EQUAL(*std::min_element(times.begin(), times.end()), 0);
+    BOOST_CHECK_CLOSE(*std::max_element(times.begin(), times.end()), 0.1, 1e-10);
+
+    // Efforts ramping over the run: first-order hold at 10 Hz against 1 kHz
+    ModelSimulation ramp(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    ramp.setUWVParameters(parameters);
+    ModelSimulation held(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    held.setUWVParameters(parameters);
+    ModelSimulation reference(DYNAMIC_KINEMATIC, 0.001, 1, 0);
+    reference.setUWVParameters(parameters);
+    for(int i = 0; i < 10; i++)
+    {
+        ramp.sendEffortRamp(effort * i, effort * (i + 1));
+        held.sendEffort(effort * (i + 0.5));
+        for(int j = 0; j < 100; j++)
+            reference.sendEffortRamp(effort * (i + j / 100.), effort * (i + (j + 1) / 100.));
+    }
+    VectorXd expected = toStateVector(reference.getPose());
+    BOOST_CHECK((toStateVector(ramp.getPose()) - expected).norm() < 1e-6);
+    BOOST_CHECK((toStateVector(ramp.getPose()) - expected).norm() < 0.1 * (toStateVector(held.getPose()) - expected).norm());
+}
+
+/**
+ * Proportional-integral surge speed controller
+ */
+struct SurgeController
+{
+    double reference;
+    double integral;
+    double last_time;
+
+    Vector6d operator()(const PoseVelocityState &state, double time)
+    {
+        double error = reference - state.linear_velocity[0];
+        integral += error * (time - last_time);
+        last_time = time;
+        Vector6d effort = Vector6d::Zero();
+        effort[0] = 10 * error + 10 * integral;
+        return effort;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(controlled_effort)
+{
+    UWVParameters parameters = loadParameters();
+    ModelSimulation controlled(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    controlled.setUWVParameters(parameters);
+    ModelSimulation stepped(DYNAMIC_KINEMATIC, 0.1 / 10, 1, 0);
+    stepped.setUWVParameters(parameters);
+
+    // Same as one sendEffort per step
+    SurgeController controller = {1, 0, 0};
+    SurgeController step_controller = controller;
+    for(int i = 0; i < 50; i++)
+    {
+        controlled.sendControlledEffort(controller);
+        for(int j = 0; j < 10; j++)
+            stepped.sendEffort(step_controller(stepped.getPose(), stepped.getCurrentTime()));
+    }
+    BOOST_CHECK(controlled.getPose().linear_velocity.isApprox(stepped.getPose().linear_velocity, 1e-10));
+    BOOST_CHECK_CLOSE(controlled.getCurrentTime(), 5, 1e-10);
+    BOOST_CHECK_CLOSE(controller.last_time, 5 - 0.01, 1e-8);
+    BOOST_CHECK_CLOSE(controlled.getPose().linear_velocity[0], 1, 1);
+
+    // Lambdas
+    Vector6d effort = Vector6d::Zero();
+    controlled.sendControlledEffort([&](const PoseVelocityState &/*state*/, double /*time*/) { return effort; });
+    BOOST_CHECK(controlled.getAcceleration().linear_acceleration[0] < 0);
+}
+
+BOOST_AUTO_TEST_CASE(multi_rate)
+{
+    UWVParameters parameters = randomParameters(COMPLEX);
+    Vector6d control_input;
+    control_input << 20, 5, -3, 1, -2, 4;
+    PoseVelocityState initial_state;
+    initial_state.linear_velocity = Vector3d(1, 0.2, -0.1);
+    initial_state.angular_velocity = Vector3d(0.01, -0.02, 0.1);
+
+    // Constant pose, same as single rate
+    ModelSimulation dynamic(DYNAMIC, 0.1, 10, 0);
+    dynamic.setUWVParameters(parameters);
+    PoseVelocityState single = dynamic.sendEffort(control_input, initial_state);
+    dynamic.setKinematicStepRatio(5);
+    PoseVelocityState multi = dynamic.sendEffort(control_input, initial_state);
+    BOOST_CHECK(toStateVector(multi).isApprox(toStateVector(single), 1e-12));
+
+    // Error growing with the ratio, also when not dividing the simulations per cycle
+    const int ratios[] = {1, 2, 4, 10};
+    VectorXd final_states[4];
+    for(size_t r = 0; r < 4; r++)
+    {
+        ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+        simulation.setUWVParameters(parameters);
+        simulation.setKinematicStepRatio(ratios[r]);
+        simulation.setPose(initial_state);
+        for(int i = 0; i < 50; i++)
+            simulation.sendEffort(control_input);
+        BOOST_CHECK_EQUAL(simulation.getKinematicStepRatio(), ratios[r]);
+        final_states[r] = toStateVector(simulation.getPose());
+    }
+    double errors[3];
+    for(size_t r = 1; r < 4; r++)
+        errors[r - 1] = (final_states[r] - final_states[0]).norm();
+    BOOST_CHECK(errors[0] < errors[1]);
+    BOOST_CHECK(errors[1] < errors[2]);
+    BOOST_CHECK(errors[2] < 1e-2 * final_states[0].norm());
+
+    BOOST_CHECK_THROW(dynamic.setKinematicStepRatio(0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(events)
+{
+    UWVParameters parameters = loadParameters();
+    Vector6d control_input = Vector6d::Zero();
+    control_input[0] = 2;
+    control_input[5] = 0.5;
+
+    // Reference crossing time of x = 0.5, from a fine simulation
+    ModelSimulation reference(DYNAMIC_KINEMATIC, 1e-4, 1, 0);
+    reference.setUWVParameters(parameters);
+    double previous_x = 0;
+    double reference_time = 0;
+    while(reference.getPose().position[0] < 0.5)
+    {
+        previous_x = reference.getPose().position[0];
+        reference.sendEffort(control_input);
+        reference_time = reference.getCurrentTime() -
+                1e-4 * (reference.getPose().position[0] - 0.5) / (reference.getPose().position[0] - previous_x);
+    }
+
+    // Large steps
+    ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.5, 5, 0);
+    simulation.setUWVParameters(parameters);
+    size_t never = simulation.addEvent([](const PoseVelocityState &state) { return state.position[0] - 0.5; }, EVENT_FALLING);
+    size_t heading = simulation.addEvent([](const PoseVelocityState &state) { return base::getYaw(state.orientation) - 0.01; },
+            EVENT_RISING, false);
+    size_t depth = simulation.addEvent([](const PoseVelocityState &state) { return state.position[0] - 0.5; });
+    BOOST_CHECK_EQUAL(never, 0);
+    bool heading_found = false;
+    while(simulation.getEventOccurrences().empty() || !simulation.getEventOccurrences().back().terminal)
+    {
+        simulation.sendEffort(control_input);
+        for(size_t i = 0; i < simulation.getEventOccurrences().size(); i++)
+        {
+            const EventOccurrence &occurrence = simulation.getEventOccurrences()[i];
+            BOOST_CHECK(occurrence.event != never);
+            if(occurrence.event == heading)
+            {
+                heading_found = true;
+                BOOST_CHECK_SMALL(base::getYaw(occurrence.state.orientation) - 0.01, 1e-9);
+            }
+        }
+        BOOST_REQUIRE(simulation.getCurrentTime() < 10);
+    }
+    BOOST_CHECK(heading_found);
+    const EventOccurrence &occurrence = simulation.getEventOccurrences().back();
+    BOOST_CHECK_EQUAL(occurrence.event, depth);
+    BOOST_CHECK_SMALL(occurrence.state.position[0] - 0.5, 1e-9);
+    BOOST_CHECK_CLOSE(occurrence.time, simulation.getCurrentTime(), 1e-12);
+    BOOST_CHECK_SMALL(occurrence.time - reference_time, 1e-5);
+    BOOST_CHECK(toStateVector(simulation.getPose()) == toStateVector(occurrence.state));
+
+    // No new crossing from the event state
+    simulation.sendEffort(control_input);
+    BOOST_CHECK(simulation.getEventOccurrences().empty());
+    simulation.clearEvents();
+}
+
+BOOST_AUTO_TEST_CASE(dense_output)
+{
+    UWVParameters parameters = loadParameters();
+    Vector6d control_input = Vector6d::Zero();
+    control_input << 2, 0.5, -0.3, 0.1, 0.2, 0.5;
+    PoseVelocityState initial_state;
+    initial_state.linear_velocity = Vector3d(0.5, 0, 0);
+
+    // Exact at the end points, for every scheme
+    const IntegrationScheme schemes[] = {EULER, HEUN, RUNGE_KUTTA_4};
+    for(size_t i = 0; i < 3; i++)
+    {
+        DynamicKinematicSimulator simulator(0.05);
+        simulator.getDynamicModel().setUWVParameters(parameters);
+        simulator.setIntegrationScheme(schemes[i]);
+        DenseOutputStep step;
+        PoseVelocityState end = simulator.calcStates(initial_state, control_input, step);
+        BOOST_CHECK(toStateVector(end) == toStateVector(simulator.calcStates(initial_state, control_input)));
+        BOOST_CHECK(toStateVector(step.interpolate(0)).isApprox(toStateVector(initial_state), 1e-12));
+        BOOST_CHECK(toStateVector(step.interpolate(1)).isApprox(toStateVector(end), 1e-12));
+    }
+
+    ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.5, 10, 0);
+    simulation.setUWVParameters(parameters);
+    simulation.setPose(initial_state);
+    BOOST_CHECK_THROW(simulation.getStateAt(0), std::runtime_error);
+    simulation.setDenseOutput(true);
+    simulation.sendEffort(control_input);
+    simulation.sendEffort(control_input);
+    BOOST_CHECK(toStateVector(simulation.getStateAt(1)).isApprox(toStateVector(simulation.getPose()), 1e-12));
+    BOOST_CHECK_THROW(simulation.getStateAt(0.4), std::invalid_argument);
+    BOOST_CHECK_THROW(simulation.getStateAt(1.1), std::invalid_argument);
+
+    // Inside the steps, against a fine simulation
+    ModelSimulation reference(DYNAMIC_KINEMATIC, 1e-3, 1, 0);
+    reference.setUWVParameters(parameters);
+    reference.setPose(initial_state);
+    for(int i = 1; i <= 1000; i++)
+    {
+        reference.sendEffort(control_input);
+        if(i > 500 && i % 13 == 0)
+        {
+            VectorXd interpolated = toStateVector(simulation.getStateAt(i * 1e-3));
+            BOOST_CHECK_SMALL((interpolated - toStateVector(reference.getPose())).norm(), 2e-6);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(current_field)
+{
+    // Linear field, reproduced exactly by the trilinear interpolation
+    Eigen::Matrix3d gradient;
+    gradient << 0.1, 0, 0.05,
+                0, -0.2, 0,
+                0.02, 0.03, 0;
+    Vector3d offset(0.5, -0.3, 0.1);
+    Vector3d origin(-2, -1, 0);
+    Vector3d spacing(1, 0.5, 2);
+    Eigen::Vector3i size(5, 4, 3);
+    std::vector<Vector3d> velocities;
+    std::ofstream file("current_grid.txt");
+    file << "# test grid" << std::endl;
+    file << "origin " << origin.transpose() << std::endl;
+    file << "spacing " << spacing.transpose() << std::endl;
+    file << "size " << size.transpose() << std::endl;
+    for(int z = 0; z < size[2]; z++)
+        for(int y = 0; y < size[1]; y++)
+            for(int x = 0; x < size[0]; x++)
+            {
+                velocities.push_back(gradient * (origin + spacing.cwiseProduct(Vector3d(x, y, z))) + offset);
+                file.precision(17);
+                file << velocities.back().transpose() << std::endl;
+            }
+    file.close();
+    std::shared_ptr<GridCurrentField> grid = std::make_shared<GridCurrentField>(origin, spacing, size, velocities);
+    GridCurrentField loaded("current_grid.txt");
+    std::remove("current_grid.txt");
+    BOOST_CHECK(loaded.getSize() == size);
+
+    CurrentFieldCache cache(grid);
+    CurrentFieldCache other_cache(std::make_shared<UniformCurrentField>(offset));
+    const Vector3d extent = spacing.cwiseProduct((size.array() - 1).cast<double>().matrix());
+    for(int i = 0; i < 100; i++)
+    {
+        Vector3d position = origin + extent.cwiseProduct((Vector3d::Random() + Vector3d::Ones()) / 2);
+        Vector3d expected = gradient * position + offset;
+        BOOST_CHECK(grid->getVelocity(position, 0, cache).isApprox(expected, 1e-12));
+        BOOST_CHECK(grid->getVelocity(position, 0, cache).isApprox(expected, 1e-12));
+        BOOST_CHECK(grid->getVelocity(position, 0, other_cache).isApprox(expected, 1e-12));
+        BOOST_CHECK(loaded.getVelocity(position, 0).isApprox(expected, 1e-12));
+    }
+    BOOST_CHECK(cache.valid);
+    // The cache of another field is not used
+    BOOST_CHECK(!other_cache.valid);
+    // Closest grid point outside of the grid
+    BOOST_CHECK(grid->getVelocity(Vector3d(-10, 0.2, 5), 0).isApprox(gradient * Vector3d(-2, 0.2, 4) + offset, 1e-12));
+    BOOST_CHECK_THROW(GridCurrentField(origin, spacing, size, std::vector<Vector3d>(3)), std::invalid_argument);
+
+    // Damping and Coriolis on the relative velocity
+    UWVParameters parameters = randomParameters(COMPLEX);
+    DynamicModel model;
+    model.setUWVParameters(parameters);
+    Vector3d current(0.3, -0.2, 0.1);
+    Orientation orientation = Orientation(Eigen::AngleAxisd(0.4, Vector3d(1, 2, 3).normalized()));
+    EvaluationContext context(orientation);
+    Vector6d velocity = Vector6d::Random();
+    Vector6d control_input = Vector6d::Random();
+    Vector6d relative_velocity = velocity;
+    relative_velocity.head<3>() -= orientation.inverse() * current;
+    BOOST_CHECK(model.calcAcceleration(control_input, velocity, current, context).isApprox(
+            model.calcAcceleration(control_input, relative_velocity, context), 1e-12));
+
+    // Drift with the current, starting at t = 1
+    ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    simulation.setUWVParameters(loadParameters());
+    simulation.setCurrentField(std::make_shared<TimeVaryingCurrentField>([&](double time)
+    {
+        return Vector3d(time < 1 ? Vector3d::Zero() : current);
+    }));
+    for(int i = 0; i < 10; i++)
+        simulation.sendEffort(Vector6d::Zero());
+    BOOST_CHECK(simulation.getPose().linear_velocity.isZero());
+    for(int i = 0; i < 300; i++)
+        simulation.sendEffort(Vector6d::Zero());
+    BOOST_CHECK(simulation.getPose().linear_velocity.isApprox(current, 1e-6));
+    BOOST_CHECK_SMALL(simulation.getPose().angular_velocity.norm(), 1e-9);
+
+    simulation.setCurrentField(std::shared_ptr<const CurrentField>());
+    for(int i = 0; i < 300; i++)
+        simulation.sendEffort(Vector6d::Zero());
+    BOOST_CHECK_SMALL(simulation.getPose().linear_velocity.norm(), 1e-6);
+
+    // Turning vehicle at rest in the water, drifting straight with the current
+    UWVParameters free_parameters = loadParameters();
+    for(size_t i = 0; i < free_parameters.damping_matrices.size(); i++)
+        free_parameters.damping_matrices[i].setZero();
+    free_parameters.buoyancy = free_parameters.weight;
+    free_parameters.distance_body2centerofbuoyancy = free_parameters.distance_body2centerofgravity;
+    ModelSimulation turning(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    turning.setUWVParameters(free_parameters);
+    turning.setCurrentField(std::make_shared<UniformCurrentField>(Vector3d(1, 0, 0)));
+    PoseVelocityState start = turning.getPose();
+    start.linear_velocity = Vector3d(1, 0, 0);
+    start.angular_velocity = Vector3d(0, 0, 0.5);
+    turning.setPose(start);
+    for(int i = 0; i < 60; i++)
+        turning.sendEffort(Vector6d::Zero());
+    PoseVelocityState end = turning.getPose();
+    BOOST_CHECK((end.orientation * end.linear_velocity).isApprox(Vector3d(1, 0, 0), 1e-6));
+    BOOST_CHECK(end.position.isApprox(Vector3d(6, 0, 0), 1e-6));
+    BOOST_CHECK_CLOSE(end.angular_velocity[2], 0.5, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(thruster_configuration)
+{
+    // Two surge thrusters on the sides and one in the middle, sway and heave thrusters
+    std::vector<ThrusterDefinition> thrusters(5);
+    thrusters[0].position = Vector3d(0, 0.3, 0);
+    thrusters[1].position = Vector3d(0, -0.3, 0);
+    thrusters[2].weight = 4;
+    thrusters[3].position = Vector3d(0.5, 0, 0);
+    thrusters[3].direction = Vector3d(0, 2, 0);
+    thrusters[4].direction = Vector3d(0, 0, 1);
+    thrusters[4].command_table = {-1, 0, 1};
+    thrusters[4].thrust_table = {-20, 0, 40};
+    ThrusterConfiguration configuration(thrusters);
+    BOOST_CHECK_EQUAL(configuration.getThrusterCount(), 5);
+
+    Vector6d column;
+    column << 0, 1, 0, 0, 0, 0.5;
+    BOOST_CHECK(configuration.getConfigurationMatrix().col(3).isApprox(column));
+    column << 1, 0, 0, 0, 0, -0.3;
+    BOOST_CHECK(configuration.getConfigurationMatrix().col(0).isApprox(column));
+
+    // Reachable efforts, allocation of least weighted norm
+    base::MatrixXd efforts = base::MatrixXd::Random(6, 10);
+    efforts.middleRows(3, 2).setZero();
+    base::MatrixXd allocated = configuration.allocateThrusts(efforts);
+    BOOST_CHECK(configuration.calcEfforts(allocated).isApprox(efforts, 1e-10));
+    base::VectorXd weights(5);
+    weights << 1, 1, 4, 1, 1;
+    Eigen::FullPivLU<base::MatrixXd> lu(configuration.getConfigurationMatrix());
+    base::MatrixXd null_space = lu.kernel();
+    BOOST_REQUIRE_EQUAL(null_space.cols(), 1);
+    BOOST_CHECK_SMALL((null_space.transpose() * weights.asDiagonal() * allocated).norm(), 1e-10);
+    BOOST_CHECK_GT(std::abs(allocated(0, 0)), std::abs(allocated(2, 0)));
+
+    // Thrust curve
+    base::MatrixXd commands = base::MatrixXd::Zero(5, 3);
+    commands.row(4) << 0.5, -0.5, 2;
+    base::MatrixXd thrusts = configuration.calcThrusts(commands);
+    BOOST_CHECK_CLOSE(thrusts(4, 0), 20, 1e-9);
+    BOOST_CHECK_CLOSE(thrusts(4, 1), -10, 1e-9);
+    BOOST_CHECK_CLOSE(thrusts(4, 2), 40, 1e-9);
+    BOOST_CHECK(configuration.calcCommands(thrusts).leftCols(2).isApprox(commands.leftCols(2)));
+    BOOST_CHECK_CLOSE(configuration.calcCommands(thrusts)(4, 2), 1, 1e-9);
+
+    thrusters[4].thrust_table = {-20, 0, 0};
+    BOOST_CHECK_THROW(ThrusterConfiguration invalid(thrusters), std::invalid_argument);
+    thrusters[4].thrust_table = {-20, 0, 40};
+
+    // Instantaneous thrusters match the resulting efforts
+    UWVParameters parameters = loadParameters();
+    ModelSimulation instantaneous(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    instantaneous.setUWVParameters(parameters);
+    instantaneous.setThrusterConfiguration(std::make_shared<ThrusterConfiguration>(thrusters));
+    ModelSimulation reference(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    reference.setUWVParameters(parameters);
+    base::VectorXd command(5);
+    command << 0.5, 0.2, 0.1, 0.3, 0.05;
+    Vector6d command_efforts = configuration.calcEfforts(configuration.calcThrusts(command));
+    for(int i = 0; i < 5; i++)
+    {
+        BOOST_CHECK(toStateVector(instantaneous.sendThrusterCommands(command)) ==
+                toStateVector(reference.sendEffort(command_efforts)));
+    }
+    BOOST_CHECK(instantaneous.getThrusts().isApprox(configuration.calcThrusts(command)));
+
+    // Lagged thrusters reach the same steady state
+    for(size_t i = 0; i < thrusters.size(); i++)
+        thrusters[i].time_constant = 0.5;
+    ModelSimulation lagged(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    lagged.setUWVParameters(parameters);
+    lagged.setThrusterConfiguration(std::make_shared<ThrusterConfiguration>(thrusters));
+    BOOST_CHECK_THROW(lagged.sendThrusterCommands(base::VectorXd::Zero(4)), std::invalid_argument);
+    lagged.sendThrusterCommands(command);
+    BOOST_CHECK(lagged.getThrusts().isApprox(configuration.calcThrusts(command) * (1 - std::exp(-0.2))));
+    ModelSimulation first_cycle(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    first_cycle.setUWVParameters(parameters);
+    BOOST_CHECK_LT(lagged.getPose().linear_velocity[0], first_cycle.sendEffort(command_efforts).linear_velocity[0]);
+    for(int i = 0; i < 300; i++)
+    {
+        lagged.sendThrusterCommands(command);
+        reference.sendEffort(command_efforts);
+    }
+    BOOST_CHECK(lagged.getPose().linear_velocity.isApprox(reference.getPose().linear_velocity, 1e-6));
+    BOOST_CHECK(lagged.getPose().angular_velocity.isApprox(reference.getPose().angular_velocity, 1e-6));
+
+    // Dense output and events of the stepping loop
+    lagged.setDenseOutput(true);
+    // Half of the distance travelled in one cycle
+    const Vector3d start_position = lagged.getPose().position;
+    const double distance = 0.5 * 0.1 * lagged.getPose().linear_velocity.norm();
+    lagged.addEvent([&](const PoseVelocityState &state) { return (state.position - start_position).norm() - distance; });
+    const double start_time = lagged.getCurrentTime();
+    PoseVelocityState event_state = lagged.sendThrusterCommands(command);
+    BOOST_REQUIRE_EQUAL(lagged.getEventOccurrences().size(), 1);
+    BOOST_CHECK_CLOSE((event_state.position - start_position).norm(), distance, 1e-6);
+    BOOST_CHECK_CLOSE(lagged.getCurrentTime() - start_time, 0.05, 1);
+    BOOST_CHECK(toStateVector(lagged.getStateAt(lagged.getCurrentTime())).isApprox(toStateVector(event_state), 1e-9));
+
+    // The thrusts only respond over the time simulated before the event
+    lagged.setThrusterConfiguration(std::make_shared<ThrusterConfiguration>(thrusters));
+    const Vector3d restart_position = lagged.getPose().position;
+    lagged.clearEvents();
+    lagged.addEvent([&](const PoseVelocityState &state) { return (state.position - restart_position).norm() - distance; });
+    const double restart_time = lagged.getCurrentTime();
+    lagged.sendThrusterCommands(command);
+    BOOST_REQUIRE_EQUAL(lagged.getEventOccurrences().size(), 1);
+    const double elapsed = lagged.getCurrentTime() - restart_time;
+    BOOST_CHECK_LT(elapsed, 0.1);
+    const ThrusterConfiguration lagged_configuration(thrusters);
+    BOOST_CHECK(lagged.getThrusts().isApprox(lagged_configuration.calcThrustResponse(base::VectorXd::Zero(5),
+            configuration.calcThrusts(command), elapsed)));
+}
+
+BOOST_AUTO_TEST_CASE(input_delay)
+{
+    UWVParameters parameters = loadParameters();
+    std::vector<Vector6d> efforts(20);
+    for(size_t k = 0; k < efforts.size(); k++)
+        efforts[k] = Vector6d::Constant(std::sin(0.3 * k)) + Vector6d::LinSpaced(0, 0.5);
+
+    // Delays shorter and longer than a cycle, not multiple of the sampling time
+    double delays[2] = {0.05, 0.13};
+    for(int d = 0; d < 2; d++)
+    {
+        ModelSimulation simulation(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+        simulation.setUWVParameters(parameters);
+        simulation.setInputDelay(delays[d]);
+        BOOST_CHECK_EQUAL(simulation.getInputDelay(), delays[d]);
+
+        // One step per cycle, delayed efforts looked up at the middle of the step
+        ModelSimulation reference(DYNAMIC_KINEMATIC, 0.01, 1, 0);
+        reference.setUWVParameters(parameters);
+        for(int k = 0; k < 20; k++)
+        {
+            simulation.sendEffort(efforts[k]);
+            for(int j = 10 * k; j < 10 * (k + 1); j++)
+            {
+                int index = std::floor((j * 0.01 + 0.005 - delays[d]) / 0.1);
+                reference.sendEffort(index < 0 ? Vector6d::Zero() : efforts[index]);
+            }
+            BOOST_CHECK(toStateVector(simulation.getPose()).isApprox(toStateVector(reference.getPose()), 1e-12));
+        }
+        // Effort sent at the middle of the last step minus the delay
+        BOOST_CHECK(simulation.getAppliedEffort() == efforts[std::floor((1.995 - delays[d]) / 0.1)]);
+    }
+
+    // Rate limit on the surge effort only
+    ModelSimulation limited(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    limited.setUWVParameters(parameters);
+    Vector6d rate = Vector6d::Constant(std::numeric_limits<double>::infinity());
+    rate[0] = 5;
+    limited.setInputRateLimit(rate);
+    limited.sendEffort(Vector6d::Ones());
+    BOOST_CHECK_CLOSE(limited.getAppliedEffort()[0], 0.5, 1e-9);
+    BOOST_CHECK(limited.getAppliedEffort().tail<5>() == Vector6d::Ones().tail<5>());
+    limited.sendEffort(Vector6d::Ones());
+    BOOST_CHECK_CLOSE(limited.getAppliedEffort()[0], 1, 1e-9);
+
+    BOOST_CHECK_THROW(limited.setInputDelay(-0.1), std::invalid_argument);
+    BOOST_CHECK_THROW(limited.setInputRateLimit(Vector6d::Zero()), std::invalid_argument);
+
+    // Same input stage for the profiles and the controllers
+    ModelSimulation sent(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    ModelSimulation profiled(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    ModelSimulation controlled(DYNAMIC_KINEMATIC, 0.1, 10, 0);
+    ModelSimulation *simulations[3] = {&sent, &profiled, &controlled};
+    for(int m = 0; m < 3; m++)
+    {
+        simulations[m]->setUWVParameters(parameters);
+        simulations[m]->setInputDelay(0.13);
+        simulations[m]->setInputRateLimit(rate);
+    }
+    for(int k = 0; k < 20; k++)
+    {
+        const Vector6d &effort = efforts[k];
+        sent.sendEffort(effort);
+        profiled.sendEffortProfile([&](double /*time*/) { return effort; });
+        controlled.sendControlledEffort([&](const PoseVelocityState &/*state*/, double /*time*/) { return effort; });
+    }
+    BOOST_CHECK(toStateVector(profiled.getPose()) == toStateVector(sent.getPose()));
+    BOOST_CHECK(toStateVector(controlled.getPose()) == toStateVector(sent.getPose()));
+    BOOST_CHECK(profiled.getAppliedEffort() == sent.getAppliedEffort());
+    // A cycle with invalid efforts, from its start or its middle, leaves the input stage unchanged
+    const Vector6d applied = profiled.getAppliedEffort();
+    for(int start = 0; start < 2; start++)
+    {
+        BOOST_CHECK_THROW(profiled.sendEffortProfile([&](double time)
+        {
+            return Vector6d(time < 0.05 * start ? efforts[0] :
+                    Vector6d::Constant(std::numeric_limits<double>::quiet_NaN()));
+        }), std::runtime_error);
+        BOOST_CHECK(profiled.getAppliedEffort() == applied);
+    }
+    sent.sendEffort(Vector6d::Ones());
+    BOOST_CHECK_NO_THROW(profiled.sendEffort(Vector6d::Ones()));
+    BOOST_CHECK(toStateVector(profiled.getPose()) == toStateVector(sent.getPose()));
+    BOOST_CHECK_THROW(sent.simulateCycle(sent.getPose(), efforts[0]), std::runtime_error);
+    BOOST_CHECK_THROW(sent.linearize(sent.getPose(), efforts[0]), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(dynamic_model_calc_efforts)
 {
     uwv_dynamic_model::DynamicModel model;
@@ -302,29 +1620,3 @@ uwv_dynamic_model::UWVParameters loadRotationalParameters(void)
     }
     return parameters;
 }
-
-
-base::Vector3d calcOmega(base::Vector3d omega0, double t, double omegan)
-{
-    base::Vector3d ome;
-    ome[0] = omega0[0]*cos(omegan*t) + omega0[1]*sin(omegan*t);
-    ome[1] = omega0[1]*cos(omegan*t) - omega0[0]*sin(omegan*t);
-    ome[2] = omega0[2];
-    return ome;
-}
-
-base::Orientation calcOrientation(base::Orientation init_ori, double t, double wn, double wi, base::Vector3d init_ang_mom)
-{
-    base::Vector3d h0 = init_ang_mom/init_ang_mom.norm();
-    double alpha = wn*t/2;
-    double betha = wi*t/2;
-
-    base::Vector4d y;
-    y[0] = h0[0]*cos(alpha)*sin(betha) + h0[1]*sin(alpha)*sin(betha);
-    y[1] = h0[1]*cos(alpha)*sin(betha) - h0[0]*sin(alpha)*sin(betha);
-    y[2] = h0[2]*cos(alpha)*sin(betha) + sin(alpha)*cos(betha);
-    y[3] = cos(alpha)*cos(betha) - h0[2]*sin(alpha)*sin(betha);
-
-    base::Orientation Y(y[3], y[0], y[1], y[2] );
-    return Y*init_ori;
-}